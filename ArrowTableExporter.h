@@ -0,0 +1,105 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file ArrowTableExporter.h
+/// \brief Writes the arrow tables of a DPL table type, one or more record
+///        batches per dataframe, into an Arrow IPC file. Uncompressed files
+///        can be memory-mapped and read in place (see
+///        read-derived-arrow.cxx), LZ4-compressed ones are smaller but
+///        are decompressed by the reader.
+/// \author
+/// \since
+
+#ifndef ARROWTABLEEXPORTER_H_
+#define ARROWTABLEEXPORTER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#include <arrow/table.h>
+#include <arrow/util/compression.h>
+
+#include "Framework/Logger.h"
+
+namespace o2::analysis::hadrex
+{
+
+class ArrowTableExporter
+{
+ public:
+  /// The file is created with the schema of the first table written
+  void open(std::string const& path, bool lz4)
+  {
+    mPath = path;
+    mOptions = arrow::ipc::IpcWriteOptions::Defaults();
+    if (lz4) {
+      auto codec = arrow::util::Codec::Create(arrow::Compression::LZ4_FRAME);
+      if (!codec.ok()) {
+        LOGF(fatal, "LZ4 codec not available: %s", codec.status().ToString());
+      }
+      mOptions.codec = std::move(codec).ValueOrDie();
+    }
+  }
+
+  void write(arrow::Table const& table)
+  {
+    if (!mWriter) {
+      auto stream = arrow::io::FileOutputStream::Open(mPath);
+      if (!stream.ok()) {
+        LOGF(fatal, "Cannot open %s: %s", mPath, stream.status().ToString());
+      }
+      mStream = *stream;
+      auto writer = arrow::ipc::MakeFileWriter(mStream, table.schema(), mOptions);
+      if (!writer.ok()) {
+        LOGF(fatal, "Cannot write %s: %s", mPath, writer.status().ToString());
+      }
+      mWriter = *writer;
+    }
+    auto status = mWriter->WriteTable(table);
+    if (!status.ok()) {
+      LOGF(fatal, "Writing %s failed: %s", mPath, status.ToString());
+    }
+    mRows += table.num_rows();
+  }
+
+  /// Writes the file footer, to be called in endOfStream()
+  void close()
+  {
+    if (!mWriter) {
+      return;
+    }
+    auto status = mWriter->Close();
+    if (status.ok()) {
+      status = mStream->Close();
+    }
+    if (!status.ok()) {
+      LOGF(fatal, "Closing %s failed: %s", mPath, status.ToString());
+    }
+    mWriter.reset();
+    LOGF(info, "%lld rows written to %s", static_cast<long long>(mRows), mPath);
+  }
+
+  int64_t rows() const { return mRows; }
+
+ private:
+  std::string mPath;
+  arrow::ipc::IpcWriteOptions mOptions;
+  std::shared_ptr<arrow::io::FileOutputStream> mStream;
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> mWriter;
+  int64_t mRows = 0;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // ARROWTABLEEXPORTER_H_
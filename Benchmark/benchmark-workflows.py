@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+# Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+# See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+# All rights not expressly granted are reserved.
+#
+# This software is distributed under the terms of the GNU General Public
+# License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+#
+# In applying this license CERN does not waive the privileges and immunities
+# granted to it by virtue of its status as an Intergovernmental Organization
+# or submit itself to any jurisdiction.
+
+"""Runs the run-h*.sh workflows a number of times and collects throughput and memory.
+
+For every repetition of every workflow the script records
+- the wall time of the whole chain and, if the workflow has an event histogram,
+  events/s from its number of entries,
+- rows/s of every process function profiled with ProcessProfiler
+  (<task>/profiling/<process> in AnalysisResults.root),
+- peak RSS and shared-memory high-water mark per device from the
+  performanceMetrics.json written by --resources-monitoring.
+
+The medians over the repetitions go into a JSON file. With --baseline, the
+medians are compared to a previous result file and the script exits with 1
+when events/s or rows/s drop, or peak RSS grows, by more than the threshold.
+
+The scripts write AnalysisResults.root and performanceMetrics.json in their
+directory (the repository, Jets for the jet workflows), from where they are
+moved to <work-dir>/<workflow>/<repetition>. The script does not start when
+one of these files exists there already.
+
+Example:
+  ./Benchmark/benchmark-workflows.py -n 5 -o bench.json h1-final h4-3
+  ./Benchmark/benchmark-workflows.py -o new.json --baseline bench.json
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import time
+
+REPO_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DEFAULT_CONFIG = os.path.join(REPO_DIR, "Benchmark", "benchmark-config.json")
+
+# bins of the ProcessProfiler histograms
+PROFILER_BINS = ["calls", "wallTime", "cpuTime", "rowsIn", "rowsOut", "rowsInRate", "rowsOutRate"]
+
+# files written by the workflows in their directory, moved to the run directory after every run
+OUTPUTS = ("AnalysisResults.root", "performanceMetrics.json")
+
+
+class ResultsFile:
+    """Minimal read access to AnalysisResults.root, with uproot or PyROOT."""
+
+    def __init__(self, path):
+        self.path = path
+        try:
+            import uproot
+
+            self.file = uproot.open(path)
+            self.backend = "uproot"
+        except ImportError:
+            import ROOT
+
+            self.file = ROOT.TFile.Open(path)
+            self.backend = "ROOT"
+
+    def histogram_paths(self):
+        if self.backend == "uproot":
+            return [key.split(";")[0] for key, cls in self.file.classnames().items() if cls.startswith("TH")]
+        paths = []
+
+        def walk(directory, prefix):
+            for key in directory.GetListOfKeys():
+                name = prefix + key.GetName()
+                if key.GetClassName().startswith("TDirectory"):
+                    walk(key.ReadObj(), name + "/")
+                elif key.GetClassName().startswith("TH"):
+                    paths.append(name)
+
+        walk(self.file, "")
+        return paths
+
+    def bin_contents(self, path):
+        """Contents of the bins 1..n"""
+        if self.backend == "uproot":
+            return [float(v) for v in self.file[path].values()]
+        hist = self.file.Get(path)
+        return [hist.GetBinContent(i) for i in range(1, hist.GetNbinsX() + 1)]
+
+    def bin_edges(self, path):
+        """Low edges of the bins 1..n and the high edge of bin n"""
+        if self.backend == "uproot":
+            return [float(v) for v in self.file[path].axis().edges()]
+        axis = self.file.Get(path).GetXaxis()
+        return [axis.GetBinLowEdge(i) for i in range(1, axis.GetNbins() + 2)]
+
+    def entries(self, path):
+        if self.backend == "uproot":
+            return float(self.file[path].member("fEntries"))
+        return self.file.Get(path).GetEntries()
+
+
+def read_profiling(results):
+    """{"<task>/<process>": {quantity: value}} for all ProcessProfiler histograms"""
+    profiling = {}
+    for path in results.histogram_paths():
+        parts = path.split("/")
+        if len(parts) >= 3 and parts[-2] == "profiling":
+            contents = results.bin_contents(path)
+            profiling["/".join(parts[:-2] + parts[-1:])] = dict(zip(PROFILER_BINS, contents))
+    return profiling
+
+
+def read_device_memory(metrics_file, rss_patterns, shm_patterns):
+    """{device: {"peakRss": value, "peakShm": value}} from performanceMetrics.json"""
+    with open(metrics_file) as f:
+        metrics = json.load(f)
+    rss_regex = re.compile("|".join(rss_patterns), re.IGNORECASE)
+    shm_regex = re.compile("|".join(shm_patterns), re.IGNORECASE)
+    devices = {}
+    for device, device_metrics in metrics.items():
+        if not isinstance(device_metrics, dict):
+            continue
+        peaks = {"peakRss": None, "peakShm": None}
+        for name, series in device_metrics.items():
+            if not isinstance(series, list):
+                continue
+            values = []
+            for point in series:
+                try:
+                    values.append(float(point["value"]))
+                except (KeyError, TypeError, ValueError):
+                    pass
+            if not values:
+                continue
+            # shm first: a name like "shm-rss" counts as shared memory
+            quantity = "peakShm" if shm_regex.search(name) else "peakRss" if rss_regex.search(name) else None
+            if quantity:
+                peaks[quantity] = max(values) if peaks[quantity] is None else max(peaks[quantity], max(values))
+        devices[device] = peaks
+    return devices
+
+
+def workflow_dir(workflow):
+    """Directory in which the workflow script runs (default: the repository)"""
+    return os.path.join(REPO_DIR, workflow.get("directory", ""))
+
+
+def existing_outputs(workflows):
+    """OUTPUTS already present in the directories of the workflows"""
+    directories = sorted({workflow_dir(workflow) for workflow in workflows})
+    return [os.path.join(directory, output) for directory in directories for output in OUTPUTS if os.path.exists(os.path.join(directory, output))]
+
+
+def run_once(name, workflow, config, run_dir, extra_opt):
+    """Runs the workflow script once in its directory and moves the outputs to run_dir"""
+    os.makedirs(run_dir, exist_ok=True)
+    work_dir = workflow_dir(workflow)
+
+    env = dict(os.environ)
+    env["HADREX_EXTRA_OPT"] = extra_opt
+    start = time.monotonic()
+    with open(os.path.join(run_dir, "log.txt"), "w") as log:
+        process = subprocess.run(["bash", workflow["script"]], cwd=work_dir, env=env, stdout=log, stderr=subprocess.STDOUT)
+    wall = time.monotonic() - start
+    if process.returncode != 0:
+        raise RuntimeError(f"{name}: {workflow['script']} exited with {process.returncode}, see {run_dir}/log.txt")
+
+    result = {"wallTime": wall, "events": None, "eventsPerSecond": None, "rowsPerSecond": {}, "devices": {}}
+    results_file = os.path.join(run_dir, "AnalysisResults.root")
+    if os.path.exists(os.path.join(work_dir, "AnalysisResults.root")):
+        shutil.move(os.path.join(work_dir, "AnalysisResults.root"), results_file)
+        results = ResultsFile(results_file)
+        if workflow.get("eventHistogram"):
+            result["events"] = results.entries(workflow["eventHistogram"])
+            result["eventsPerSecond"] = result["events"] / wall if wall > 0 else None
+        for process_name, quantities in read_profiling(results).items():
+            result["rowsPerSecond"][process_name] = quantities["rowsInRate"]
+    metrics_file = os.path.join(run_dir, "performanceMetrics.json")
+    if os.path.exists(os.path.join(work_dir, "performanceMetrics.json")):
+        shutil.move(os.path.join(work_dir, "performanceMetrics.json"), metrics_file)
+        result["devices"] = read_device_memory(metrics_file, config["rssMetrics"], config["shmMetrics"])
+    return result
+
+
+def median_or_none(values):
+    values = [v for v in values if v is not None]
+    return statistics.median(values) if values else None
+
+
+def summarise(runs):
+    """Medians over the repetitions of one workflow"""
+    summary = {
+        "wallTime": median_or_none([r["wallTime"] for r in runs]),
+        "eventsPerSecond": median_or_none([r["eventsPerSecond"] for r in runs]),
+        "rowsPerSecond": {},
+        "devices": {},
+    }
+    for process_name in sorted({p for r in runs for p in r["rowsPerSecond"]}):
+        summary["rowsPerSecond"][process_name] = median_or_none([r["rowsPerSecond"].get(process_name) for r in runs])
+    for device in sorted({d for r in runs for d in r["devices"]}):
+        summary["devices"][device] = {
+            quantity: median_or_none([r["devices"].get(device, {}).get(quantity) for r in runs]) for quantity in ("peakRss", "peakShm")
+        }
+    return summary
+
+
+def compare(current, baseline, threshold):
+    """List of regressions beyond the threshold (relative)"""
+    regressions = []
+
+    def check(label, new, old, higher_is_better):
+        if new is None or old is None or old == 0:
+            return
+        change = (new - old) / old
+        if (higher_is_better and change < -threshold) or (not higher_is_better and change > threshold):
+            regressions.append(f"{label}: {old:.4g} -> {new:.4g} ({change:+.1%})")
+
+    for name, summary in current.items():
+        old = baseline.get(name)
+        if old is None:
+            continue
+        check(f"{name} events/s", summary["eventsPerSecond"], old.get("eventsPerSecond"), True)
+        for process_name, rate in summary["rowsPerSecond"].items():
+            check(f"{name} {process_name} rows/s", rate, old.get("rowsPerSecond", {}).get(process_name), True)
+        for device, peaks in summary["devices"].items():
+            old_peaks = old.get("devices", {}).get(device, {})
+            check(f"{name} {device} peak RSS", peaks["peakRss"], old_peaks.get("peakRss"), False)
+            check(f"{name} {device} peak shm", peaks["peakShm"], old_peaks.get("peakShm"), False)
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("workflows", nargs="*", help="workflows to run (default: all in the configuration)")
+    parser.add_argument("-c", "--config", default=DEFAULT_CONFIG, help="benchmark configuration")
+    parser.add_argument("-n", "--repetitions", type=int, help="repetitions per workflow")
+    parser.add_argument("-o", "--output", default="benchmark-results.json", help="result file")
+    parser.add_argument("-w", "--work-dir", default="benchmark-runs", help="directory keeping the outputs of every run")
+    parser.add_argument("--baseline", help="previous result file to compare with")
+    parser.add_argument("--threshold", type=float, help="relative change counted as a regression")
+    parser.add_argument("--extra-opt", default="", help="extra DPL options, passed to the scripts as HADREX_EXTRA_OPT")
+    args = parser.parse_args()
+
+    with open(args.config) as f:
+        config = json.load(f)
+    repetitions = args.repetitions or config["repetitions"]
+    threshold = args.threshold if args.threshold is not None else config["threshold"]
+    names = args.workflows or list(config["workflows"])
+    for name in names:
+        if name not in config["workflows"]:
+            parser.error(f"unknown workflow {name}")
+    # the outputs of every run are moved away, files found before the first run belong to someone else
+    existing = existing_outputs(config["workflows"][name] for name in names)
+    if existing:
+        print("the workflows would overwrite " + ", ".join(existing) + ", move these files away first")
+        return 1
+
+    summaries = {}
+    for name in names:
+        runs = []
+        for repetition in range(repetitions):
+            run_dir = os.path.join(os.path.abspath(args.work_dir), name, str(repetition))
+            print(f"{name}: run {repetition + 1}/{repetitions}", flush=True)
+            runs.append(run_once(name, config["workflows"][name], config, run_dir, args.extra_opt))
+        summaries[name] = summarise(runs)
+        summaries[name]["runs"] = runs
+        rate = summaries[name]["eventsPerSecond"]
+        print(f"{name}: {summaries[name]['wallTime']:.1f} s" + (f", {rate:.1f} events/s" if rate else ""), flush=True)
+
+    with open(args.output, "w") as f:
+        json.dump(summaries, f, indent=2)
+    print(f"results written to {args.output}")
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        regressions = compare(summaries, baseline, threshold)
+        for regression in regressions:
+            print(f"REGRESSION {regression}")
+        if regressions:
+            return 1
+        print(f"no regression beyond {threshold:.0%} with respect to {args.baseline}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,445 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file kernel-benchmarks.cxx
+/// \brief Micro-benchmarks of the inner kernels of the h1-h4 workflows on
+///        synthetic in-memory columns, without DPL and without an AO2D:
+///        - h2: the ComputeDeltaPhi pair loop (computeDeltaPhiReference and
+///          TH1::Fill per pair), the CorrelationEngine that replaced it, and
+///          the CorrelationContainer of processMultiDim,
+///        - h3: the V0 topological and PID selection and mass filling of
+///          processV0Candidate,
+///        - h4-3: the D0 selection, invariant masses and collision ordering
+///          of ProduceDerivedTable::process,
+///        - h1: the track selection and resolution fill of
+///          momentumresolution::processColumnar.
+///        The kernels are the headers the tasks call (CorrelationEngine.h,
+///        CorrelationContainer.h, V0CandidateKernel.h, D0CandidateKernel.h,
+///        TrackResolutionKernel.h, FillBuffer.h, McTruthCache.h,
+///        ResolutionAccumulator.h, RecoDecay), fed from plain columns; only
+///        the table access and the Filters of vzeromcexample are written
+///        here.
+///
+///        Every benchmark reports the time per row (time/row), rows/s
+///        (items_per_second) and the calls to operator new per kernel call
+///        (allocs/call) after one warm-up call. For the pair kernels a row
+///        is a pair.
+/// \author
+/// \since
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "TH1F.h"
+#include "TH2F.h"
+
+#include "Common/Core/RecoDecay.h"
+
+#include "../CorrelationContainer.h"
+#include "../CorrelationEngine.h"
+#include "../D0CandidateKernel.h"
+#include "../FillBuffer.h"
+#include "../McTruthCache.h"
+#include "../ResolutionAccumulator.h"
+#include "../TrackResolutionKernel.h"
+#include "../V0CandidateKernel.h"
+
+using namespace o2::analysis::hadrex;
+
+// Every operator new of the process is counted; the aligned storage of
+// CorrelationContainer (std::aligned_alloc) is not
+namespace
+{
+std::atomic<uint64_t> nAllocations{0};
+} // namespace
+
+void* operator new(std::size_t size)
+{
+  nAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace
+{
+
+/// Runs kernel() once untimed, so that the scratch storage reaches its
+/// steady-state size as in a task processing many dataframes, then in the
+/// timed loop; kernel() returns the rows it processed
+template <typename TKernel>
+void runKernel(benchmark::State& state, TKernel&& kernel)
+{
+  kernel();
+  const uint64_t first = nAllocations.load(std::memory_order_relaxed);
+  int64_t rows = 0;
+  for (auto _ : state) {
+    rows += kernel();
+  }
+  const double allocations = nAllocations.load(std::memory_order_relaxed) - first;
+  state.SetItemsProcessed(rows);
+  state.counters["time/row"] = benchmark::Counter(rows, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["allocs/call"] = benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+}
+
+constexpr uint32_t seed = 12345;
+
+float uniformPhi(std::mt19937& rng)
+{
+  return std::uniform_real_distribution<float>(0.f, 2.f * static_cast<float>(M_PI))(rng);
+}
+
+//----------------------------------------------------------------------------
+// h2: trigger x associate delta phi, the argument is the number of tracks of
+// the collision, a quarter of them are triggers
+
+void fillParticles(ParticleArrays& triggers, ParticleArrays& associates, int nTracks)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> eta(-0.8f, 0.8f);
+  for (int i = 0; i < nTracks; ++i) {
+    (i % 4 == 0 ? triggers : associates).push_back(uniformPhi(rng), eta(rng));
+  }
+}
+
+// the tutorial pair loop: ComputeDeltaPhi and TH1::Fill for every combination
+void BM_h2DeltaPhiReference(benchmark::State& state)
+{
+  ParticleArrays triggers, associates;
+  fillParticles(triggers, associates, state.range(0));
+  TH1F histogram("correlationFunction", "", 40, -0.5 * M_PI, 1.5 * M_PI);
+  runKernel(state, [&]() -> int64_t {
+    for (std::size_t iTrig = 0; iTrig < triggers.size(); ++iTrig) {
+      for (std::size_t iAssoc = 0; iAssoc < associates.size(); ++iAssoc) {
+        histogram.Fill(computeDeltaPhiReference(triggers.phi[iTrig], associates.phi[iAssoc]));
+      }
+    }
+    return triggers.size() * associates.size();
+  });
+}
+BENCHMARK(BM_h2DeltaPhiReference)->RangeMultiplier(4)->Range(16, 1024);
+
+void BM_h2CorrelationEngine(benchmark::State& state)
+{
+  ParticleArrays triggers, associates;
+  fillParticles(triggers, associates, state.range(0));
+  TH1F histogram("correlationFunction", "", 40, -0.5 * M_PI, 1.5 * M_PI);
+  CorrelationEngine engine;
+  engine.setBinning(40, -0.5 * M_PI, 1.5 * M_PI);
+  runKernel(state, [&]() -> int64_t {
+    engine.correlate(triggers, associates);
+    const int64_t nPairs = engine.nPairs();
+    engine.flush(&histogram);
+    return nPairs;
+  });
+}
+BENCHMARK(BM_h2CorrelationEngine)->RangeMultiplier(4)->Range(16, 1024);
+
+// processMultiDim with the default axes of h2-final
+void BM_h2CorrelationContainer(benchmark::State& state)
+{
+  const int nTracks = state.range(0);
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> eta(-0.8f, 0.8f);
+  std::exponential_distribution<float> pt(1.f);
+  std::vector<float> trackPt, trackEta, trackPhi;
+  for (int i = 0; i < nTracks; ++i) {
+    trackPt.push_back(2.f + pt(rng));
+    trackEta.push_back(eta(rng));
+    trackPhi.push_back(uniformPhi(rng));
+  }
+  CorrelationContainer container;
+  container.setAxes({0., 4.0, 6.0, 8.0, 10.0}, {0., 2.0, 3.0, 4.0, 6.0}, {32, -1.6, 1.6}, {36, -0.5 * M_PI, 1.5 * M_PI});
+  runKernel(state, [&]() -> int64_t {
+    uint64_t nPairsBefore = container.nPairs();
+    container.fill(trackPt.data(), trackEta.data(), trackPhi.data(), nTracks);
+    return container.nPairs() - nPairsBefore;
+  });
+}
+BENCHMARK(BM_h2CorrelationContainer)->RangeMultiplier(4)->Range(16, 1024);
+
+//----------------------------------------------------------------------------
+// h3: V0 selection and mass filling, the argument is the number of V0s
+
+struct V0Columns {
+  std::vector<float> dcaPosToPV, dcaNegToPV, dcaV0Daughters, radius;
+  std::vector<double> cosPA;
+  std::vector<int32_t> posTrackId, negTrackId;
+  std::vector<float> mK0Short, mLambda, mAntiLambda;
+  std::vector<int32_t> pdgCode;
+  // daughter track columns, read through the track indices as posTrack_as() does
+  std::vector<float> tpcNSigmaPr, tpcNSigmaPi;
+
+  explicit V0Columns(int n)
+  {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dca(0.f, 0.3f), nSigma(0.f, 3.f), massWidth(0.f, 0.01f);
+    std::uniform_real_distribution<float> dcaDaughters(0.f, 1.5f), decayRadius(0.f, 30.f);
+    std::exponential_distribution<double> pointing(30.);
+    std::discrete_distribution<int> species({0.5, 0.15, 0.15, 0.2});
+    const std::array<int32_t, 4> codes = {310, 3122, -3122, 0};
+    const int nTracks = 10 * n;
+    for (int i = 0; i < nTracks; ++i) {
+      tpcNSigmaPr.push_back(nSigma(rng));
+      tpcNSigmaPi.push_back(nSigma(rng));
+    }
+    std::uniform_int_distribution<int32_t> track(0, nTracks - 1);
+    for (int i = 0; i < n; ++i) {
+      dcaPosToPV.push_back(dca(rng));
+      dcaNegToPV.push_back(dca(rng));
+      dcaV0Daughters.push_back(dcaDaughters(rng));
+      radius.push_back(decayRadius(rng));
+      cosPA.push_back(1. - pointing(rng));
+      posTrackId.push_back(track(rng));
+      negTrackId.push_back(track(rng));
+      mK0Short.push_back(0.4976f + massWidth(rng));
+      mLambda.push_back(1.1157f + massWidth(rng));
+      mAntiLambda.push_back(1.1157f + massWidth(rng));
+      pdgCode.push_back(codes[species(rng)]);
+    }
+  }
+};
+
+// the Filters of vzeromcexample (default cuts) followed by processV0Candidate
+void BM_h3V0Candidates(benchmark::State& state)
+{
+  const int nV0s = state.range(0);
+  const V0Columns v0s(nV0s);
+  const double v0cospa = 0.97;
+  const float dcav0dau = 1.0, dcanegtopv = .1, dcapostopv = .1, v0radius = 0.5;
+  TH1F hMassK0Short("hMassK0Short", "", 200, 0.450f, 0.550f);
+  TH1F hMassLambda("hMassLambda", "", 200, 1.015f, 1.215f);
+  TH1F hMassAntiLambda("hMassAntiLambda", "", 200, 1.015f, 1.215f);
+  TH1F hMassTrueK0Short("hMassTrueK0Short", "", 200, 0.450f, 0.550f);
+  TH1F hMassTrueLambda("hMassTrueLambda", "", 200, 1.015f, 1.215f);
+  TH1F hMassTrueAntiLambda("hMassTrueAntiLambda", "", 200, 1.015f, 1.215f);
+  const std::array<TH1*, nV0Species> hMass = {&hMassK0Short, &hMassLambda, &hMassAntiLambda};
+  const std::array<TH1*, nV0Species> hMassTrue = {&hMassTrueK0Short, &hMassTrueLambda, &hMassTrueAntiLambda};
+  runKernel(state, [&]() -> int64_t {
+    for (int i = 0; i < nV0s; ++i) {
+      if (!(std::abs(v0s.dcaPosToPV[i]) > dcapostopv && std::abs(v0s.dcaNegToPV[i]) > dcanegtopv && v0s.dcaV0Daughters[i] < dcav0dau && v0s.cosPA[i] > v0cospa && v0s.radius[i] > v0radius)) {
+        continue;
+      }
+      const int32_t posTrack = v0s.posTrackId[i];
+      const int32_t negTrack = v0s.negTrackId[i];
+      auto pid = v0PidHypotheses(v0s.tpcNSigmaPr[posTrack], v0s.tpcNSigmaPr[posTrack], v0s.tpcNSigmaPi[negTrack], v0s.tpcNSigmaPi[negTrack]);
+      fillV0Masses(pid, {v0s.mK0Short[i], v0s.mLambda[i], v0s.mAntiLambda[i]}, v0TrueSpecies(v0s.pdgCode[i]), hMass, hMassTrue);
+    }
+    return nV0s;
+  });
+}
+BENCHMARK(BM_h3V0Candidates)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+//----------------------------------------------------------------------------
+// h4-3: D0 selection and invariant masses, the argument is the number of
+// 2-prong candidates of the dataframe
+
+struct Cand2ProngColumns {
+  std::vector<uint8_t> hfflag;
+  std::vector<int32_t> collisionId;
+  std::vector<float> pt, cpa;
+  std::vector<std::array<float, 3>> pVectorProng0, pVectorProng1;
+
+  explicit Cand2ProngColumns(int n)
+  {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> momentum(0.f, 2.f);
+    std::uniform_real_distribution<float> pointing(0.8f, 1.f), flag(0.f, 1.f);
+    std::poisson_distribution<int> candidatesPerCollision(3.);
+    int collision = 0, nLeft = 0;
+    for (int i = 0; i < n; ++i) {
+      while (nLeft == 0) {
+        nLeft = candidatesPerCollision(rng);
+        collision++;
+      }
+      nLeft--;
+      collisionId.push_back(collision);
+      hfflag.push_back(flag(rng) < 0.6f ? 1 : 2); // bit 0: aod::hf_cand_2prong::DecayType::D0ToPiK
+      pVectorProng0.push_back({momentum(rng), momentum(rng), momentum(rng)});
+      pVectorProng1.push_back({momentum(rng), momentum(rng), momentum(rng)});
+      pt.push_back(std::hypot(pVectorProng0.back()[0] + pVectorProng1.back()[0], pVectorProng0.back()[1] + pVectorProng1.back()[1]));
+      cpa.push_back(pointing(rng));
+    }
+  }
+};
+
+// ProduceDerivedTable::process with the float output: the rows that the
+// Produces cursors would write go to plain vectors
+void BM_h43D0Selection(benchmark::State& state)
+{
+  const int nCandidates = state.range(0);
+  const Cand2ProngColumns cands(nCandidates);
+  const std::array<double, 2> massesPiK = {0.13957039, 0.493677};
+  const std::array<double, 2> massesKPi = {0.493677, 0.13957039};
+  D0CandidateKernel selected;
+  std::array<std::vector<float>, D0CandidateKernel::nColumns> outColumns;
+  std::vector<int32_t> outCollisionId, sliceCollisionId, sliceOffset, sliceSize;
+  runKernel(state, [&]() -> int64_t {
+    selected.clear();
+    for (auto& column : outColumns) {
+      column.clear();
+    }
+    outCollisionId.clear();
+    sliceCollisionId.clear();
+    sliceOffset.clear();
+    sliceSize.clear();
+
+    for (int i = 0; i < nCandidates; ++i) {
+      if (!isSelectedD0(cands.hfflag[i] & 1, cands.pt[i])) {
+        continue;
+      }
+      const std::array<std::array<float, 3>, 2> pVectors = {cands.pVectorProng0[i], cands.pVectorProng1[i]};
+      auto invMassD0 = RecoDecay::m(pVectors, massesPiK);
+      auto invMassD0bar = RecoDecay::m(pVectors, massesKPi);
+      selected.add(cands.collisionId[i], {static_cast<float>(invMassD0), static_cast<float>(invMassD0bar), cands.pt[i], cands.cpa[i]});
+    }
+
+    selected.write(
+      [&](int collisionId, int offset, int nInCollision) {
+        sliceCollisionId.push_back(collisionId);
+        sliceOffset.push_back(offset);
+        sliceSize.push_back(nInCollision);
+      },
+      [&](auto const& values, int collisionId) {
+        for (int iColumn = 0; iColumn < D0CandidateKernel::nColumns; ++iColumn) {
+          outColumns[iColumn].push_back(values[iColumn]);
+        }
+        outCollisionId.push_back(collisionId);
+      });
+    benchmark::DoNotOptimize(selected.zoneMin().data());
+    benchmark::DoNotOptimize(selected.zoneMax().data());
+    return nCandidates;
+  });
+}
+BENCHMARK(BM_h43D0Selection)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+//----------------------------------------------------------------------------
+// h1: track selection and pT resolution, the argument is the number of
+// tracks of the dataframe
+
+/// McParticles stand-in for McTruthCache::update
+struct McParticleColumns {
+  struct Mothers {
+    const int32_t* first;
+    bool empty() const { return *first < 0; }
+    int32_t operator[](int) const { return *first; }
+  };
+  struct Row {
+    McParticleColumns const* table;
+    int64_t index;
+    int32_t pdgCode() const { return table->pdg[index]; }
+    float pt() const { return table->ptMc[index]; }
+    Mothers mothersIds() const { return {&table->mother[index]}; }
+    Row const& operator*() const { return *this; }
+    Row& operator++()
+    {
+      ++index;
+      return *this;
+    }
+    bool operator!=(Row const& other) const { return index != other.index; }
+  };
+  std::vector<int32_t> pdg, mother;
+  std::vector<float> ptMc;
+
+  int64_t size() const { return pdg.size(); }
+  Row begin() const { return {this, 0}; }
+  Row end() const { return {this, size()}; }
+};
+
+struct TrackColumns {
+  std::vector<uint8_t> tpcNClsFindable;
+  std::vector<int8_t> tpcNClsFindableMinusCrossedRows;
+  std::vector<float> dcaXY, eta, pt;
+  std::vector<int32_t> collisionId, mcParticleId;
+  McParticleColumns mcParticles;
+
+  explicit TrackColumns(int n)
+  {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> findable(60, 159), missing(0, 40);
+    std::normal_distribution<float> dca(0.f, 0.15f), smearing(0.f, 0.02f);
+    std::uniform_real_distribution<float> pseudorapidity(-1.f, 1.f), unit(0.f, 1.f);
+    std::exponential_distribution<float> transverseMomentum(2.f);
+    const int nMc = 2 * n;
+    for (int i = 0; i < nMc; ++i) {
+      mcParticles.pdg.push_back(211);
+      mcParticles.mother.push_back(-1);
+      mcParticles.ptMc.push_back(0.15f + transverseMomentum(rng));
+    }
+    std::uniform_int_distribution<int> label(0, nMc - 1);
+    for (int i = 0; i < n; ++i) {
+      tpcNClsFindable.push_back(findable(rng));
+      tpcNClsFindableMinusCrossedRows.push_back(missing(rng));
+      dcaXY.push_back(dca(rng));
+      eta.push_back(pseudorapidity(rng));
+      collisionId.push_back(unit(rng) < 0.05f ? -1 : i / 50);
+      const int32_t mc = unit(rng) < 0.1f ? -1 : label(rng);
+      mcParticleId.push_back(mc);
+      pt.push_back(mc < 0 ? 0.15f + transverseMomentum(rng) : mcParticles.ptMc[mc] * (1.f + smearing(rng)));
+    }
+  }
+};
+
+// momentumresolution::processColumnar with the resoHistogram and the
+// resolution accumulators filled; the MC cache is rebuilt at every call, as
+// at the start of a dataframe
+void BM_h1TrackSelectionResolution(benchmark::State& state)
+{
+  const int nTracks = state.range(0);
+  const TrackColumns tracks(nTracks);
+  FillBuffer1D etaBuffer, ptBuffer;
+  FillBuffer2D resoBuffer;
+  etaBuffer.attach(std::make_shared<TH1F>("etaHistogram", "", 100, -1., +1));
+  ptBuffer.attach(std::make_shared<TH1F>("ptHistogram", "", 100, 0., 10.0));
+  resoBuffer.attach(std::make_shared<TH2F>("resoHistogram", "", 100, 0., 10.0, 100, -.5, .5));
+  ResolutionAccumulator resolution;
+  resolution.setBinning(100, 0., 10.0);
+  McTruthCache mcTruth;
+  TrackResolutionKernel kernel;
+  runKernel(state, [&]() -> int64_t {
+    kernel.select(tracks.tpcNClsFindable.data(), tracks.tpcNClsFindableMinusCrossedRows.data(), tracks.dcaXY.data(), tracks.collisionId.data(), nTracks);
+    kernel.compact(tracks.pt.data(), tracks.mcParticleId.data(), [&](int64_t row) {
+      etaBuffer.fill(tracks.eta[row]);
+      ptBuffer.fill(tracks.pt[row]);
+    });
+    mcTruth.invalidate();
+    mcTruth.update(tracks.mcParticles);
+    kernel.resolve(mcTruth, [&](float trackPt, float delta) {
+      resoBuffer.fill(trackPt, delta);
+      resolution.fill(trackPt, delta);
+    });
+    etaBuffer.flush();
+    ptBuffer.flush();
+    resoBuffer.flush();
+    return nTracks;
+  });
+}
+BENCHMARK(BM_h1TrackSelectionResolution)->RangeMultiplier(8)->Range(1 << 10, 1 << 19);
+
+} // namespace
+
+BENCHMARK_MAIN();
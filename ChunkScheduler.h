@@ -0,0 +1,142 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file ChunkScheduler.h
+/// \brief Splits a row range into fixed-size chunks processed by a pool of
+///        worker threads started once. Idle workers take the next chunk from
+///        a shared counter, so uneven chunks balance out. Each call to the
+///        body gets the worker index, to be used to select per-worker state.
+/// \author
+/// \since
+
+#ifndef CHUNKSCHEDULER_H_
+#define CHUNKSCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace o2::analysis::hadrex
+{
+
+/// Worker threads kept across calls, so that a call costs a wake-up and
+/// not a thread start per worker; worker 0 is the calling thread
+class ChunkPool
+{
+ public:
+  explicit ChunkPool(int nWorkers) : mNWorkers(std::max(nWorkers, 1))
+  {
+    for (int worker = 1; worker < mNWorkers; ++worker) {
+      mThreads.emplace_back([this, worker]() { run(worker); });
+    }
+  }
+  ChunkPool(ChunkPool const&) = delete;
+  ChunkPool& operator=(ChunkPool const&) = delete;
+
+  ~ChunkPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mWake.notify_all();
+    for (auto& thread : mThreads) {
+      thread.join();
+    }
+  }
+
+  int nWorkers() const { return mNWorkers; }
+
+  /// Calls body(worker, begin, end) for every chunk [begin, end) of [0, nRows)
+  /// and returns when all chunks are done. A single chunk runs on the calling
+  /// thread without waking the workers
+  template <typename F>
+  void forEachChunk(int64_t nRows, int64_t chunkSize, F const& body)
+  {
+    const int64_t nChunks = (nRows + chunkSize - 1) / chunkSize;
+    if (nChunks <= 1 || mThreads.empty()) {
+      for (int64_t begin = 0; begin < nRows; begin += chunkSize) {
+        body(0, begin, std::min(begin + chunkSize, nRows));
+      }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mBody = &body;
+      mInvoke = [](void const* f, int worker, int64_t begin, int64_t end) { (*static_cast<F const*>(f))(worker, begin, end); };
+      mNRows = nRows;
+      mChunkSize = chunkSize;
+      mNChunks = nChunks;
+      mNextChunk = 0;
+      mPending = static_cast<int>(mThreads.size());
+      mGeneration++;
+    }
+    mWake.notify_all();
+    work(0);
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this]() { return mPending == 0; });
+  }
+
+ private:
+  void work(int worker)
+  {
+    for (int64_t chunk = mNextChunk++; chunk < mNChunks; chunk = mNextChunk++) {
+      const int64_t begin = chunk * mChunkSize;
+      mInvoke(mBody, worker, begin, std::min(begin + mChunkSize, mNRows));
+    }
+  }
+
+  void run(int worker)
+  {
+    uint64_t generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [&]() { return mStop || mGeneration != generation; });
+        if (mStop) {
+          return;
+        }
+        generation = mGeneration;
+      }
+      work(worker);
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPending--;
+      }
+      mDone.notify_one();
+    }
+  }
+
+  int mNWorkers;
+  std::vector<std::thread> mThreads;
+  std::mutex mMutex;
+  std::condition_variable mWake; // a new call or the end of the pool
+  std::condition_variable mDone; // a worker finished its part of the call
+  bool mStop = false;
+  uint64_t mGeneration = 0;
+  int mPending = 0;
+
+  // current call, written under the mutex before the workers are woken
+  void const* mBody = nullptr;
+  void (*mInvoke)(void const*, int, int64_t, int64_t) = nullptr;
+  int64_t mNRows = 0;
+  int64_t mChunkSize = 1;
+  int64_t mNChunks = 0;
+  std::atomic<int64_t> mNextChunk{0};
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // CHUNKSCHEDULER_H_
@@ -0,0 +1,155 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file ColumnCodec.h
+/// \brief 16-bit encodings of float columns of derived tables: fixed point
+///        over a declared range with a declared resolution, or IEEE 754
+///        half precision. The codec parameters are stored next to the data
+///        so that the reader can decode without any configuration.
+/// \author
+/// \since
+
+#ifndef COLUMNCODEC_H_
+#define COLUMNCODEC_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace o2::analysis::hadrex
+{
+
+enum class ColumnEncoding : int8_t {
+  kFixedPoint16 = 1, // (x - min) / resolution, with one code each for below min and above max
+  kFloat16 = 2       // IEEE 754 binary16, round to nearest even
+};
+
+/// float -> binary16, overflow to infinity, NaN kept
+inline uint16_t floatToHalf(float value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  const uint32_t absBits = bits & 0x7fffffffu;
+  if (absBits >= 0x7f800000u) { // inf or NaN
+    return sign | 0x7c00u | (absBits > 0x7f800000u ? 0x200u : 0u);
+  }
+  if (absBits >= 0x477ff000u) { // rounds above the largest half
+    return sign | 0x7c00u;
+  }
+  if (absBits < 0x38800000u) { // subnormal half or zero
+    if (absBits < 0x33000000u) {
+      return sign;
+    }
+    const uint32_t exponent = absBits >> 23;
+    const uint32_t mantissa = (absBits & 0x7fffffu) | 0x800000u;
+    const uint32_t shift = 126 - exponent;
+    uint32_t half = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+      ++half;
+    }
+    return sign | half;
+  }
+  uint32_t half = ((absBits - 0x38000000u) >> 13);
+  const uint32_t remainder = absBits & 0x1fffu;
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+    ++half;
+  }
+  return sign | half;
+}
+
+/// binary16 -> float, exact
+inline float halfToFloat(uint16_t half)
+{
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1fu;
+  const uint32_t mantissa = half & 0x3ffu;
+  uint32_t bits;
+  if (exponent == 0x1fu) {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa != 0) {
+    float value = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -value : value;
+  } else {
+    bits = sign;
+  }
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+struct ColumnCodec {
+  static constexpr uint16_t kUnderflow = 0;
+  static constexpr uint16_t kOverflow = 65535; // also NaN, as for TH1::Fill
+  static constexpr float kMaxSteps = 65533.f;
+
+  ColumnEncoding encoding = ColumnEncoding::kFloat16;
+  float min = 0.f;
+  float max = 1.f;
+  float resolution = 0.f; // fixed point only, <= 0 means the finest step covering [min, max]
+
+  /// Step of the fixed-point encoding
+  float step() const { return resolution > 0.f ? resolution : (max - min) / kMaxSteps; }
+
+  /// False if the fixed-point range cannot be covered by 16 bits at this resolution
+  bool isValid() const
+  {
+    if (encoding == ColumnEncoding::kFloat16) {
+      return true;
+    }
+    return max > min && (max - min) / step() <= kMaxSteps + 0.5f;
+  }
+
+  uint16_t encode(float value) const
+  {
+    if (encoding == ColumnEncoding::kFloat16) {
+      return floatToHalf(value);
+    }
+    if (value < min) {
+      return kUnderflow;
+    }
+    if (!(value <= max)) {
+      return kOverflow;
+    }
+    float code = 1.f + std::round((value - min) / step());
+    return static_cast<uint16_t>(std::min(code, kMaxSteps + 1.f));
+  }
+
+  float decode(uint16_t code) const
+  {
+    if (encoding == ColumnEncoding::kFloat16) {
+      return halfToFloat(code);
+    }
+    if (code == kUnderflow) {
+      return -INFINITY;
+    }
+    if (code == kOverflow) {
+      return INFINITY;
+    }
+    return min + (code - 1) * step();
+  }
+
+  /// Round-trip error of one value, 0 outside the fixed-point range
+  float roundTripError(float value) const
+  {
+    float decoded = decode(encode(value));
+    return std::isfinite(decoded) && std::isfinite(value) ? std::abs(decoded - value) : 0.f;
+  }
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // COLUMNCODEC_H_
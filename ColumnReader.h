@@ -0,0 +1,82 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file ColumnReader.h
+/// \brief Contiguous access to a numeric column of an arrow table.
+///        Single-chunk columns (the usual case in a DPL dataframe) are read
+///        in place, chunked ones are copied once into a local buffer.
+/// \author
+/// \since
+
+#ifndef COLUMNREADER_H_
+#define COLUMNREADER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <arrow/table.h>
+#include <arrow/type_traits.h>
+
+#include "Framework/Logger.h"
+
+namespace o2::analysis::hadrex
+{
+
+template <typename T>
+class ColumnReader
+{
+  using ArrayType = typename arrow::CTypeTraits<T>::ArrayType;
+
+ public:
+  /// Columns are addressed by their AO2D name, e.g. "fPt" for aod::track::Pt
+  ColumnReader(arrow::Table const& table, const char* name)
+  {
+    auto column = table.GetColumnByName(name);
+    if (!column) {
+      LOGF(fatal, "Column %s not found", name);
+    }
+    mSize = column->length();
+    if (column->num_chunks() == 1) {
+      mData = std::static_pointer_cast<ArrayType>(column->chunk(0))->raw_values();
+      return;
+    }
+    mCopy.resize(mSize);
+    int64_t offset = 0;
+    for (auto const& chunk : column->chunks()) {
+      auto values = std::static_pointer_cast<ArrayType>(chunk)->raw_values();
+      std::copy(values, values + chunk->length(), mCopy.begin() + offset);
+      offset += chunk->length();
+    }
+    mData = mCopy.data();
+  }
+
+  // a copy would point into the buffer of the source; moving a vector keeps
+  // its buffer, so mData stays valid in the moved-to reader
+  ColumnReader(ColumnReader const&) = delete;
+  ColumnReader& operator=(ColumnReader const&) = delete;
+  ColumnReader(ColumnReader&&) = default;
+  ColumnReader& operator=(ColumnReader&&) = default;
+
+  T const* data() const { return mData; }
+  int64_t size() const { return mSize; }
+  T operator[](int64_t row) const { return mData[row]; }
+
+ private:
+  T const* mData = nullptr;
+  int64_t mSize = 0;
+  std::vector<T> mCopy;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // COLUMNREADER_H_
@@ -0,0 +1,284 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file CorrelationContainer.h
+/// \brief Fixed-binning two-particle correlation counts in
+///        (pT trigger, pT associate, delta eta, delta phi), stored as one
+///        flat cache-aligned array with delta phi running fastest. ROOT
+///        histograms are only made at output time, one delta eta x delta phi
+///        TH2 per pT bin pair. Instances filled separately (e.g. one per
+///        thread) are combined with merge().
+/// \author
+/// \since
+
+#ifndef CORRELATIONCONTAINER_H_
+#define CORRELATIONCONTAINER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include "TH1.h"
+#include "TH2.h"
+
+#include "CorrelationEngine.h"
+
+namespace o2::analysis::hadrex
+{
+
+/// Allocator aligning the storage to a cache line
+template <typename T, std::size_t Alignment = 64>
+struct CacheAlignedAllocator {
+  using value_type = T;
+  template <typename U>
+  struct rebind {
+    using other = CacheAlignedAllocator<U, Alignment>;
+  };
+
+  CacheAlignedAllocator() = default;
+  template <typename U>
+  CacheAlignedAllocator(CacheAlignedAllocator<U, Alignment> const&)
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    std::size_t bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+    void* p = std::aligned_alloc(Alignment, bytes);
+    if (!p) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(p);
+  }
+  void deallocate(T* p, std::size_t) { std::free(p); }
+
+  template <typename U>
+  bool operator==(CacheAlignedAllocator<U, Alignment> const&) const { return true; }
+  template <typename U>
+  bool operator!=(CacheAlignedAllocator<U, Alignment> const&) const { return false; }
+};
+
+/// Axis given in the ConfigurableAxis layout: {nBins, min, max} for fixed
+/// binning, {0 (VARIABLE_WIDTH), edge0, edge1, ...} for variable binning
+class CorrelationAxis
+{
+ public:
+  CorrelationAxis() = default;
+  explicit CorrelationAxis(std::vector<double> const& spec)
+  {
+    if (spec.size() >= 3 && spec[0] == 0.) {
+      mEdges.assign(spec.begin() + 1, spec.end());
+    } else if (spec.size() == 3 && spec[0] >= 1.) {
+      const int n = static_cast<int>(spec[0]);
+      for (int i = 0; i <= n; ++i) {
+        mEdges.push_back(spec[1] + (spec[2] - spec[1]) * i / n);
+      }
+    }
+    if (mEdges.size() < 2 || !std::is_sorted(mEdges.begin(), mEdges.end())) {
+      throw std::invalid_argument("CorrelationAxis: expected {nBins, min, max} or {0, increasing edges...}");
+    }
+  }
+
+  int nBins() const { return static_cast<int>(mEdges.size()) - 1; }
+  double min() const { return mEdges.front(); }
+  double max() const { return mEdges.back(); }
+  std::vector<double> const& edges() const { return mEdges; }
+
+  /// True if all bins have the same width (up to rounding of the edges)
+  bool isUniform() const
+  {
+    const double width = (max() - min()) / nBins();
+    for (int i = 0; i < nBins(); ++i) {
+      if (std::abs(mEdges[i + 1] - mEdges[i] - width) > 1e-9 * (max() - min())) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Bin in [0, nBins), -1 outside the axis
+  int findBin(double x) const
+  {
+    if (!(x >= mEdges.front() && x < mEdges.back())) {
+      return -1;
+    }
+    return static_cast<int>(std::upper_bound(mEdges.begin(), mEdges.end(), x) - mEdges.begin()) - 1;
+  }
+
+ private:
+  std::vector<double> mEdges;
+};
+
+class CorrelationContainer
+{
+ public:
+  using Counts = std::vector<uint64_t, CacheAlignedAllocator<uint64_t>>;
+
+  /// The delta eta and delta phi axes must be of fixed width (throws
+  /// otherwise); delta phi is expected to span 2pi, as for CorrelationEngine
+  void setAxes(std::vector<double> const& ptTrig, std::vector<double> const& ptAssoc, std::vector<double> const& deltaEta, std::vector<double> const& deltaPhi)
+  {
+    mPtTrig = CorrelationAxis(ptTrig);
+    mPtAssoc = CorrelationAxis(ptAssoc);
+    mDeltaEta = CorrelationAxis(deltaEta);
+    mDeltaPhi = CorrelationAxis(deltaPhi);
+    if (!mDeltaEta.isUniform() || !mDeltaPhi.isUniform()) {
+      throw std::invalid_argument("CorrelationContainer: the delta eta and delta phi axes must have bins of equal width");
+    }
+    mEtaMin = mDeltaEta.min();
+    mEtaMax = mDeltaEta.max();
+    mEtaInvWidth = mDeltaEta.nBins() / (mEtaMax - mEtaMin);
+    mPhiMin = mDeltaPhi.min();
+    mPhiInvWidth = mDeltaPhi.nBins() / (mDeltaPhi.max() - mPhiMin);
+    // one more cell collects the pairs outside the delta eta axis
+    mCounts.assign(static_cast<std::size_t>(mPtTrig.nBins()) * mPtAssoc.nBins() * mDeltaEta.nBins() * mDeltaPhi.nBins() + 1, 0);
+    mTriggers.assign(mPtTrig.nBins(), 0);
+    mAssocEta.resize(mPtAssoc.nBins());
+    mAssocPhi.resize(mPtAssoc.nBins());
+    mNPairs = 0;
+  }
+
+  /// All pairs of one event, each particle being a trigger and an associate
+  /// candidate; pairs of a particle with itself are not counted
+  void fill(const float* pt, const float* eta, const float* phi, std::size_t n)
+  {
+    const int nAssocBins = mPtAssoc.nBins();
+    for (int j = 0; j < nAssocBins; ++j) {
+      mAssocEta[j].clear();
+      mAssocPhi[j].clear();
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      int j = mPtAssoc.findBin(pt[i]);
+      if (j >= 0) {
+        mAssocEta[j].push_back(eta[i]);
+        mAssocPhi[j].push_back(phi[i]);
+      }
+    }
+
+    const std::size_t trash = mCounts.size() - 1;
+    const std::size_t cellsPerPtBin = static_cast<std::size_t>(mDeltaEta.nBins()) * mDeltaPhi.nBins();
+    const int nPhiBins = mDeltaPhi.nBins();
+    const int lastPhiBin = nPhiBins - 1;
+    const int lastEtaBin = mDeltaEta.nBins() - 1;
+    // the axis range is tested in double, as by the TH2 edges, and the bin is
+    // clamped: the float product can round up to nBins just below etaMax
+    const double etaMin = mEtaMin, etaMax = mEtaMax;
+    const float etaMinF = mEtaMin, etaInvWidth = mEtaInvWidth;
+    const float phiMin = mPhiMin, phiInvWidth = mPhiInvWidth;
+    uint64_t* counts = mCounts.data();
+    for (std::size_t i = 0; i < n; ++i) {
+      const int t = mPtTrig.findBin(pt[i]);
+      if (t < 0) {
+        continue;
+      }
+      ++mTriggers[t];
+      for (int j = 0; j < nAssocBins; ++j) {
+        const std::size_t offset = (static_cast<std::size_t>(t) * nAssocBins + j) * cellsPerPtBin;
+        const float* assocEta = mAssocEta[j].data();
+        const float* assocPhi = mAssocPhi[j].data();
+        const std::size_t nAssoc = mAssocEta[j].size();
+        for (std::size_t k = 0; k < nAssoc; ++k) {
+          const float deltaEta = assocEta[k] - eta[i];
+          const float deltaPhi = wrapDeltaPhi(assocPhi[k] - phi[i], phiMin);
+          const int etaBin = std::min(std::max(static_cast<int>((deltaEta - etaMinF) * etaInvWidth), 0), lastEtaBin);
+          const int phiBin = std::min(std::max(static_cast<int>((deltaPhi - phiMin) * phiInvWidth), 0), lastPhiBin);
+          const bool inside = deltaEta >= etaMin && deltaEta < etaMax;
+          ++counts[inside ? offset + etaBin * nPhiBins + phiBin : trash];
+        }
+        mNPairs += nAssoc;
+      }
+      // remove the pair of the trigger with itself, counted with zero deltas
+      const int j = mPtAssoc.findBin(pt[i]);
+      if (j >= 0) {
+        const std::size_t offset = (static_cast<std::size_t>(t) * nAssocBins + j) * cellsPerPtBin;
+        const int etaBin = std::min(std::max(static_cast<int>(-etaMinF * etaInvWidth), 0), lastEtaBin);
+        const int phiBin = std::min(std::max(static_cast<int>((wrapDeltaPhi(0.f, phiMin) - phiMin) * phiInvWidth), 0), lastPhiBin);
+        const bool inside = 0. >= etaMin && 0. < etaMax;
+        --counts[inside ? offset + etaBin * nPhiBins + phiBin : trash];
+        --mNPairs;
+      }
+    }
+  }
+
+  /// Adds the counts of a container with the same axes
+  void merge(CorrelationContainer const& other)
+  {
+    if (other.mCounts.size() != mCounts.size() || other.mTriggers.size() != mTriggers.size()) {
+      throw std::invalid_argument("CorrelationContainer::merge: different axes");
+    }
+    for (std::size_t i = 0; i < mCounts.size(); ++i) {
+      mCounts[i] += other.mCounts[i];
+    }
+    for (std::size_t i = 0; i < mTriggers.size(); ++i) {
+      mTriggers[i] += other.mTriggers[i];
+    }
+    mNPairs += other.mNPairs;
+  }
+
+  /// Pairs of one pT bin pair, at (delta eta bin + 1, delta phi bin + 1) of a TH2 with the same axes
+  void copyTo(int ptTrigBin, int ptAssocBin, TH2* histogram) const
+  {
+    const std::size_t cellsPerPtBin = static_cast<std::size_t>(mDeltaEta.nBins()) * mDeltaPhi.nBins();
+    const uint64_t* counts = mCounts.data() + (static_cast<std::size_t>(ptTrigBin) * mPtAssoc.nBins() + ptAssocBin) * cellsPerPtBin;
+    double entries = 0.;
+    for (int etaBin = 0; etaBin < mDeltaEta.nBins(); ++etaBin) {
+      for (int phiBin = 0; phiBin < mDeltaPhi.nBins(); ++phiBin) {
+        const double count = counts[etaBin * mDeltaPhi.nBins() + phiBin];
+        histogram->SetBinContent(etaBin + 1, phiBin + 1, count);
+        entries += count;
+      }
+    }
+    histogram->SetEntries(entries);
+  }
+
+  /// Number of triggers per trigger pT bin, at bin + 1 of a TH1
+  void copyTriggersTo(TH1* histogram) const
+  {
+    double entries = 0.;
+    for (int t = 0; t < mPtTrig.nBins(); ++t) {
+      histogram->SetBinContent(t + 1, mTriggers[t]);
+      entries += mTriggers[t];
+    }
+    histogram->SetEntries(entries);
+  }
+
+  CorrelationAxis const& ptTrigAxis() const { return mPtTrig; }
+  CorrelationAxis const& ptAssocAxis() const { return mPtAssoc; }
+  CorrelationAxis const& deltaEtaAxis() const { return mDeltaEta; }
+  CorrelationAxis const& deltaPhiAxis() const { return mDeltaPhi; }
+  Counts const& counts() const { return mCounts; }
+  std::vector<uint64_t> const& triggers() const { return mTriggers; }
+  /// Pairs counted, including those outside the delta eta axis
+  uint64_t nPairs() const { return mNPairs; }
+
+ private:
+  CorrelationAxis mPtTrig;
+  CorrelationAxis mPtAssoc;
+  CorrelationAxis mDeltaEta;
+  CorrelationAxis mDeltaPhi;
+  double mEtaMin = 0., mEtaMax = 1.;
+  float mEtaInvWidth = 1.f;
+  float mPhiMin = 0.f, mPhiInvWidth = 1.f;
+  Counts mCounts;
+  std::vector<uint64_t> mTriggers;
+  uint64_t mNPairs = 0;
+  // per-event associates grouped by associate pT bin
+  std::vector<std::vector<float>> mAssocEta;
+  std::vector<std::vector<float>> mAssocPhi;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // CORRELATIONCONTAINER_H_
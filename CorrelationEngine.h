@@ -0,0 +1,180 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file CorrelationEngine.h
+/// \brief Branch-free delta phi pair kernel for two-particle correlations.
+///        Trigger and associate kinematics are copied into contiguous float
+///        arrays once per collision, pairs are binned into a local integer
+///        histogram and the result is flushed into ROOT once per collision.
+/// \author
+/// \since
+
+#ifndef CORRELATIONENGINE_H_
+#define CORRELATIONENGINE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "TH1.h"
+#include "TMath.h"
+
+#include "FillBuffer.h"
+
+namespace o2::analysis::hadrex
+{
+
+/// Original tutorial delta phi, based on inner and vector products.
+/// Returns phi2 - phi1 in [-pi/2, 3pi/2). Kept as the reference for validation.
+/// Collinear pairs (|sin(phi2 - phi1)| <= 1e-8) give 0, the antiparallel ones
+/// included (see isAntiparallelReference).
+inline double computeDeltaPhiReference(double phi1, double phi2)
+{
+  //To be completely sure, use inner products
+  double x1 = TMath::Cos(phi1);
+  double y1 = TMath::Sin(phi1);
+  double x2 = TMath::Cos(phi2);
+  double y2 = TMath::Sin(phi2);
+  double lInnerProd = x1 * x2 + y1 * y2;
+  double lVectorProd = x1 * y2 - x2 * y1;
+
+  double lReturnVal = 0;
+  if (lVectorProd > 1e-8) {
+    lReturnVal = TMath::ACos(lInnerProd);
+  }
+  if (lVectorProd < -1e-8) {
+    lReturnVal = -TMath::ACos(lInnerProd);
+  }
+
+  if (lReturnVal < -TMath::Pi() / 2.) {
+    lReturnVal += 2. * TMath::Pi();
+  }
+
+  return lReturnVal;
+}
+
+/// True for the pairs to which computeDeltaPhiReference returns 0 while
+/// their delta phi is pi, within |sin(delta phi)| <= 1e-8; the pair kernel
+/// puts them at pi
+inline bool isAntiparallelReference(double phi1, double phi2)
+{
+  double lInnerProd = TMath::Cos(phi1) * TMath::Cos(phi2) + TMath::Sin(phi1) * TMath::Sin(phi2);
+  double lVectorProd = TMath::Cos(phi1) * TMath::Sin(phi2) - TMath::Cos(phi2) * TMath::Sin(phi1);
+  return std::abs(lVectorProd) <= 1e-8 && lInnerProd < 0;
+}
+
+/// Wraps a phi difference into [minimum, minimum + 2pi) without branches
+inline float wrapDeltaPhi(float deltaPhi, float minimum)
+{
+  constexpr float twoPi = 2.f * static_cast<float>(M_PI);
+  constexpr float invTwoPi = 1.f / twoPi;
+  return deltaPhi - twoPi * std::floor((deltaPhi - minimum) * invTwoPi);
+}
+
+/// Contiguous per-collision storage of the particles entering the pair loop
+struct ParticleArrays {
+  std::vector<float> phi;
+  std::vector<float> eta;
+
+  void clear()
+  {
+    phi.clear();
+    eta.clear();
+  }
+  void push_back(float p, float e)
+  {
+    phi.push_back(p);
+    eta.push_back(e);
+  }
+  std::size_t size() const { return phi.size(); }
+  bool empty() const { return phi.empty(); }
+};
+
+/// Delta phi (associate - trigger) pair kernel with a local fixed-binning histogram.
+/// The binning is expected to span 2pi, as in the correlationFunction of the tutorial.
+/// The pairs are binned as by TH1::Fill, so the float rounding of the wrap
+/// can put a pair in the under- or overflow.
+class CorrelationEngine
+{
+ public:
+  void setBinning(int nBins, double min, double max)
+  {
+    mBinning = UniformBinning(nBins, min, max);
+    mCounts.assign(nBins + 2, 0);
+  }
+
+  /// Accumulates all trigger-associate pairs into the local histogram
+  void correlate(ParticleArrays const& triggers, ParticleArrays const& associates)
+  {
+    const std::size_t nAssoc = associates.size();
+    if (nAssoc == 0) {
+      return;
+    }
+    mDeltaPhi.resize(nAssoc);
+    mBins.resize(nAssoc);
+    const float* assocPhi = associates.phi.data();
+    float* deltaPhi = mDeltaPhi.data();
+    int* bins = mBins.data();
+    const float min = mBinning.min;
+    for (const float trigPhi : triggers.phi) {
+      // no branches and no calls but floor: the compiler vectorises both loops
+      for (std::size_t i = 0; i < nAssoc; ++i) {
+        deltaPhi[i] = wrapDeltaPhi(assocPhi[i] - trigPhi, min);
+      }
+      mBinning.findBins(deltaPhi, nAssoc, bins);
+      for (std::size_t i = 0; i < nAssoc; ++i) {
+        ++mCounts[bins[i]];
+      }
+      mNPairs += nAssoc;
+    }
+  }
+
+  /// Adds the local histogram, under- and overflow included, to a TH1 with the same binning and clears it.
+  /// Mean and RMS are recomputed from the bin contents (histograms without Sumw2),
+  /// the entries grow by the number of pairs as with TH1::Fill.
+  void flush(TH1* histogram)
+  {
+    if (mNPairs == 0) {
+      return;
+    }
+    double entries = histogram->GetEntries();
+    for (int bin = 0; bin < static_cast<int>(mCounts.size()); ++bin) {
+      if (mCounts[bin] > 0) {
+        histogram->AddBinContent(bin, mCounts[bin]);
+      }
+    }
+    histogram->ResetStats();
+    histogram->SetEntries(entries + mNPairs);
+    reset();
+  }
+
+  void reset()
+  {
+    std::fill(mCounts.begin(), mCounts.end(), 0);
+    mNPairs = 0;
+  }
+
+  /// Counts with the bin numbering of TH1, 0 is the underflow and nBins + 1 the overflow
+  std::vector<uint32_t> const& counts() const { return mCounts; }
+  uint64_t nPairs() const { return mNPairs; }
+
+ private:
+  UniformBinning mBinning;
+  uint64_t mNPairs = 0;
+  std::vector<uint32_t> mCounts; // local histogram, flushed once per collision
+  std::vector<float> mDeltaPhi;  // scratch delta phi of one trigger row
+  std::vector<int> mBins;        // scratch bin indices of one trigger row
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // CORRELATIONENGINE_H_
@@ -0,0 +1,110 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file D0CandidateKernel.h
+/// \brief D0 selection and collision ordering of ProduceDerivedTable (h4-3)
+///        on plain values: the selected candidates of a dataframe are
+///        written out ordered by collision, one slice per collision, with
+///        the min/max of every column for the zone map. Shared with the
+///        kernel benchmarks.
+/// \author
+/// \since
+
+#ifndef D0CANDIDATEKERNEL_H_
+#define D0CANDIDATEKERNEL_H_
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace o2::analysis::hadrex
+{
+
+/// D0 candidates with pT > 4 GeV/c, isD0ToPiK is the D0ToPiK bit of hfflag
+inline bool isSelectedD0(bool isD0ToPiK, float pt)
+{
+  return isD0ToPiK && pt >= 4.;
+}
+
+class D0CandidateKernel
+{
+ public:
+  /// invariant mass D0, invariant mass D0bar, pT, cos(theta_P)
+  static constexpr int nColumns = 4;
+  using Values = std::array<float, nColumns>;
+
+  /// Starts a dataframe
+  void clear()
+  {
+    mSelected.clear();
+    mZoneMin.fill(std::numeric_limits<float>::infinity());
+    mZoneMax.fill(-std::numeric_limits<float>::infinity());
+  }
+
+  void add(int collisionId, Values const& values) { mSelected.push_back({collisionId, values}); }
+
+  /// Orders the candidates added since clear() by collision, the candidates
+  /// of one collision keep their input order, then calls
+  /// writeSlice(collisionId, offset, nCandidates) at the first row of every
+  /// collision and writeRow(values, collisionId) for every row; returns the
+  /// rows written. The zone min/max are taken over zoneValues(values), the
+  /// values as a reader will see them
+  template <typename FSlice, typename FRow, typename FZone>
+  int write(FSlice&& writeSlice, FRow&& writeRow, FZone&& zoneValues)
+  {
+    std::stable_sort(mSelected.begin(), mSelected.end(), [](auto const& a, auto const& b) { return a.collisionId < b.collisionId; });
+
+    int nRows = 0;
+    for (auto const& candidate : mSelected) {
+      auto const& values = candidate.values;
+      const Values zone = zoneValues(values);
+      for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+        mZoneMin[iColumn] = std::min(mZoneMin[iColumn], zone[iColumn]);
+        mZoneMax[iColumn] = std::max(mZoneMax[iColumn], zone[iColumn]);
+      }
+
+      // a new collision starts a new slice
+      if (nRows == 0 || candidate.collisionId != mSelected[nRows - 1].collisionId) {
+        int nCandidates = std::upper_bound(mSelected.begin() + nRows, mSelected.end(), candidate.collisionId, [](int id, auto const& c) { return id < c.collisionId; }) - (mSelected.begin() + nRows);
+        writeSlice(candidate.collisionId, nRows, nCandidates);
+      }
+      nRows++;
+      writeRow(values, candidate.collisionId);
+    }
+    return nRows;
+  }
+
+  /// Same, with the zone min/max taken over the values as they are written
+  template <typename FSlice, typename FRow>
+  int write(FSlice&& writeSlice, FRow&& writeRow)
+  {
+    return write(std::forward<FSlice>(writeSlice), std::forward<FRow>(writeRow), [](Values const& values) { return values; });
+  }
+
+  /// min/max of the columns written since clear(), +inf/-inf if none
+  Values const& zoneMin() const { return mZoneMin; }
+  Values const& zoneMax() const { return mZoneMax; }
+
+ private:
+  struct SelectedCandidate {
+    int collisionId;
+    Values values;
+  };
+  std::vector<SelectedCandidate> mSelected;
+  Values mZoneMin;
+  Values mZoneMax;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // D0CANDIDATEKERNEL_H_
@@ -0,0 +1,119 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file DerivedTables.h
+/// \brief Derived D0 tables written by ProduceDerivedTable (h4-3) and read
+///        back by ReadDerivedTable (h4-3, h4-final)
+/// \author
+/// \since
+
+#ifndef DERIVEDTABLES_H_
+#define DERIVEDTABLES_H_
+
+#include "Framework/AnalysisDataModel.h"
+
+namespace o2::aod
+{
+namespace mytable
+{
+DECLARE_SOA_COLUMN(InvMassD0, invMassD0, float);           //!
+DECLARE_SOA_COLUMN(InvMassD0bar, invMassD0bar, float);     //!
+DECLARE_SOA_COLUMN(Pt, pt, float);                         //!
+DECLARE_SOA_COLUMN(CosinePointing, cosinePointing, float); //!
+DECLARE_SOA_INDEX_COLUMN(Collision, collision);            //!
+} // namespace mytable
+
+DECLARE_SOA_TABLE(MyTable, "AOD", "MYTABLE", //!
+                  mytable::InvMassD0,
+                  mytable::InvMassD0bar,
+                  mytable::Pt,
+                  mytable::CosinePointing,
+                  mytable::CollisionId)
+
+// Same content as MyTable with the float columns stored as 16-bit codes,
+// see ColumnCodec.h. The codec of each column is stored in MyTableCodecs.
+namespace mytablecompact
+{
+DECLARE_SOA_COLUMN(InvMassD0Code, invMassD0Code, uint16_t);           //!
+DECLARE_SOA_COLUMN(InvMassD0barCode, invMassD0barCode, uint16_t);     //!
+DECLARE_SOA_COLUMN(PtCode, ptCode, uint16_t);                         //!
+DECLARE_SOA_COLUMN(CosinePointingCode, cosinePointingCode, uint16_t); //!
+} // namespace mytablecompact
+
+DECLARE_SOA_TABLE(MyTableCompact, "AOD", "MYTABLECOMPACT", //!
+                  mytablecompact::InvMassD0Code,
+                  mytablecompact::InvMassD0barCode,
+                  mytablecompact::PtCode,
+                  mytablecompact::CosinePointingCode,
+                  mytable::CollisionId)
+
+// One row per MyTableCompact column and dataframe, in column order
+namespace mytablecodec
+{
+DECLARE_SOA_COLUMN(Encoding, encoding, int8_t);     //! ColumnEncoding
+DECLARE_SOA_COLUMN(Min, min, float);                //!
+DECLARE_SOA_COLUMN(Max, max, float);                //!
+DECLARE_SOA_COLUMN(Resolution, resolution, float);  //!
+DECLARE_SOA_COLUMN(MaxError, maxError, float);      //! max round-trip error in this dataframe
+} // namespace mytablecodec
+
+DECLARE_SOA_TABLE(MyTableCodecs, "AOD", "MYTABLECODEC", //!
+                  mytablecodec::Encoding,
+                  mytablecodec::Min,
+                  mytablecodec::Max,
+                  mytablecodec::Resolution,
+                  mytablecodec::MaxError)
+
+// Zone map: per-dataframe row count and min/max of each MyTable column,
+// written by the producer next to MyTable / MyTableCompact
+namespace myzonemap
+{
+DECLARE_SOA_COLUMN(NRows, nRows, int32_t);                         //!
+DECLARE_SOA_COLUMN(MinInvMassD0, minInvMassD0, float);             //!
+DECLARE_SOA_COLUMN(MaxInvMassD0, maxInvMassD0, float);             //!
+DECLARE_SOA_COLUMN(MinInvMassD0bar, minInvMassD0bar, float);       //!
+DECLARE_SOA_COLUMN(MaxInvMassD0bar, maxInvMassD0bar, float);       //!
+DECLARE_SOA_COLUMN(MinPt, minPt, float);                           //!
+DECLARE_SOA_COLUMN(MaxPt, maxPt, float);                           //!
+DECLARE_SOA_COLUMN(MinCosinePointing, minCosinePointing, float);   //!
+DECLARE_SOA_COLUMN(MaxCosinePointing, maxCosinePointing, float);   //!
+} // namespace myzonemap
+
+DECLARE_SOA_TABLE(MyZoneMaps, "AOD", "MYZONEMAP", //!
+                  myzonemap::NRows,
+                  myzonemap::MinInvMassD0,
+                  myzonemap::MaxInvMassD0,
+                  myzonemap::MinInvMassD0bar,
+                  myzonemap::MaxInvMassD0bar,
+                  myzonemap::MinPt,
+                  myzonemap::MaxPt,
+                  myzonemap::MinCosinePointing,
+                  myzonemap::MaxCosinePointing)
+
+// MyTable (or MyTableCompact) rows are ordered by collision. One row per
+// collision with candidates gives the rows [offset, offset + nCandidates) of
+// that collision, counted from the start of the dataframe of the producer.
+// Merging dataframes does not rebase the offsets: the reader does, as they
+// restart at 0 with every merged part (see ReadDerivedTable)
+namespace mycollisionslice
+{
+DECLARE_SOA_COLUMN(Offset, offset, int32_t);           //!
+DECLARE_SOA_COLUMN(NCandidates, nCandidates, int32_t); //!
+} // namespace mycollisionslice
+
+DECLARE_SOA_TABLE(MyCollisionSlices, "AOD", "MYCOLLSLICE", //!
+                  mytable::CollisionId,
+                  mycollisionslice::Offset,
+                  mycollisionslice::NCandidates)
+
+} // namespace o2::aod
+
+#endif // DERIVEDTABLES_H_
@@ -0,0 +1,236 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file FillBuffer.h
+/// \brief Buffered filling of fixed-binning TH1/TH2 histograms.
+///        Values are collected in contiguous buffers, binned in one pass
+///        into a plain count array and merged into the ROOT histogram with
+///        one AddBinContent per non-empty bin, typically once per dataframe.
+///        Bin contents and entries are the same as with TH1::Fill, the
+///        mean/RMS are recomputed from the bin contents. Meant for
+///        histograms without Sumw2 which are not filled directly elsewhere.
+/// \author
+/// \since
+
+#ifndef FILLBUFFER_H_
+#define FILLBUFFER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "TH1.h"
+
+namespace o2::analysis::hadrex
+{
+
+/// Fixed-width binning computed with the formula of TAxis::FindFixBin,
+/// 1 + int(nBins * (x - min) / (max - min)); bin 0 is the underflow and bin
+/// nBins + 1 the overflow (NaN included)
+struct UniformBinning {
+  int nBins = 1;
+  double min = 0.;
+  double max = 1.;
+
+  UniformBinning() = default;
+  UniformBinning(int n, double lo, double hi) : nBins(n), min(lo), max(hi) {}
+  explicit UniformBinning(TAxis const* axis) : nBins(axis->GetNbins()), min(axis->GetXmin()), max(axis->GetXmax()) {}
+
+  /// Bins n values into bins[], branch free so that the loop vectorises.
+  /// The position is clamped to [0, nBins] before the conversion to int,
+  /// which is undefined for NaN and out-of-range values; the under- and
+  /// overflow are then selected on the value itself
+  void findBins(const float* values, std::size_t n, int* bins) const
+  {
+    const double lo = min;
+    const double hi = max;
+    const double width = max - min;
+    const double last = nBins;
+    const int overflow = nBins + 1;
+    for (std::size_t i = 0; i < n; ++i) {
+      double x = values[i];
+      double position = last * (x - lo) / width;
+      position = position > 0. ? position : 0.; // NaN goes to 0 here
+      position = position < last ? position : last;
+      int bin = std::min(1 + static_cast<int>(position), nBins);
+      bin = x < hi ? bin : overflow;
+      bins[i] = x < lo ? 0 : bin;
+    }
+  }
+  int findBin(float value) const
+  {
+    int bin;
+    findBins(&value, 1, &bin);
+    return bin;
+  }
+};
+
+/// Plain count array with the global bin layout of a TH1/TH2 (under/overflow included)
+class BinnedCounts
+{
+ public:
+  void setSize(std::size_t nCells)
+  {
+    mCounts.assign(nCells, 0);
+    mEntries = 0;
+  }
+
+  void add(const int* globalBins, std::size_t n)
+  {
+    for (std::size_t i = 0; i < n; ++i) {
+      ++mCounts[globalBins[i]];
+    }
+    mEntries += n;
+  }
+
+  void merge(BinnedCounts const& other)
+  {
+    for (std::size_t i = 0; i < mCounts.size(); ++i) {
+      mCounts[i] += other.mCounts[i];
+    }
+    mEntries += other.mEntries;
+  }
+
+  /// Adds the counts to the histogram and clears them
+  void mergeInto(TH1* histogram)
+  {
+    if (mEntries == 0) {
+      return;
+    }
+    double entries = histogram->GetEntries();
+    for (std::size_t i = 0; i < mCounts.size(); ++i) {
+      if (mCounts[i] > 0) {
+        histogram->AddBinContent(i, mCounts[i]);
+      }
+    }
+    histogram->ResetStats();
+    histogram->SetEntries(entries + mEntries);
+    std::fill(mCounts.begin(), mCounts.end(), 0);
+    mEntries = 0;
+  }
+
+  std::vector<uint64_t> const& counts() const { return mCounts; }
+  uint64_t entries() const { return mEntries; }
+
+ private:
+  std::vector<uint64_t> mCounts;
+  uint64_t mEntries = 0;
+};
+
+/// Fill buffer for a 1D histogram
+class FillBuffer1D
+{
+ public:
+  void attach(std::shared_ptr<TH1> histogram, std::size_t capacity = 8192)
+  {
+    mHistogram = histogram;
+    mBinning = UniformBinning(histogram->GetXaxis());
+    mCounts.setSize(mBinning.nBins + 2);
+    mCapacity = capacity;
+    mValues.reserve(capacity);
+    mBins.resize(capacity);
+  }
+
+  void fill(float x)
+  {
+    mValues.push_back(x);
+    if (mValues.size() == mCapacity) {
+      binPending();
+    }
+  }
+
+  /// Bins the buffered values into the count array
+  void binPending()
+  {
+    mBinning.findBins(mValues.data(), mValues.size(), mBins.data());
+    mCounts.add(mBins.data(), mValues.size());
+    mValues.clear();
+  }
+
+  /// Merges everything filled so far into the histogram
+  void flush()
+  {
+    binPending();
+    mCounts.mergeInto(mHistogram.get());
+  }
+
+ private:
+  std::shared_ptr<TH1> mHistogram;
+  UniformBinning mBinning;
+  BinnedCounts mCounts;
+  std::size_t mCapacity = 0;
+  std::vector<float> mValues;
+  std::vector<int> mBins;
+};
+
+/// Fill buffer for a 2D histogram
+class FillBuffer2D
+{
+ public:
+  void attach(std::shared_ptr<TH1> histogram, std::size_t capacity = 8192)
+  {
+    mHistogram = histogram;
+    mBinningX = UniformBinning(histogram->GetXaxis());
+    mBinningY = UniformBinning(histogram->GetYaxis());
+    mCounts.setSize((mBinningX.nBins + 2) * (mBinningY.nBins + 2));
+    mCapacity = capacity;
+    mValuesX.reserve(capacity);
+    mValuesY.reserve(capacity);
+    mBinsX.resize(capacity);
+    mBinsY.resize(capacity);
+  }
+
+  void fill(float x, float y)
+  {
+    mValuesX.push_back(x);
+    mValuesY.push_back(y);
+    if (mValuesX.size() == mCapacity) {
+      binPending();
+    }
+  }
+
+  void binPending()
+  {
+    const std::size_t n = mValuesX.size();
+    mBinningX.findBins(mValuesX.data(), n, mBinsX.data());
+    mBinningY.findBins(mValuesY.data(), n, mBinsY.data());
+    // global bin as in TH1::GetBin(binx, biny)
+    const int strideY = mBinningX.nBins + 2;
+    for (std::size_t i = 0; i < n; ++i) {
+      mBinsX[i] += strideY * mBinsY[i];
+    }
+    mCounts.add(mBinsX.data(), n);
+    mValuesX.clear();
+    mValuesY.clear();
+  }
+
+  void flush()
+  {
+    binPending();
+    mCounts.mergeInto(mHistogram.get());
+  }
+
+ private:
+  std::shared_ptr<TH1> mHistogram;
+  UniformBinning mBinningX;
+  UniformBinning mBinningY;
+  BinnedCounts mCounts;
+  std::size_t mCapacity = 0;
+  std::vector<float> mValuesX;
+  std::vector<float> mValuesY;
+  std::vector<int> mBinsX;
+  std::vector<int> mBinsY;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // FILLBUFFER_H_
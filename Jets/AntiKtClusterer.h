@@ -0,0 +1,365 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file AntiKtClusterer.h
+/// \brief Anti-kT clustering of charged tracks, E-scheme recombination and
+///        rapidity-azimuth distances as in FastJet. The particles are kept in
+///        contiguous arrays and binned in rapidity-azimuth tiles at least R
+///        wide, so that the geometric nearest neighbour of a particle is
+///        searched in the 3x3 surrounding tiles only. The next pair to merge
+///        is taken from a min-heap of the per-particle distances (stale
+///        entries are skipped), as in the FastJet N2MinHeapTiled strategy.
+///        clusterNaive() is the plain O(N^3) algorithm, kept for validation.
+/// \author
+/// \since
+
+#ifndef JETS_ANTIKTCLUSTERER_H_
+#define JETS_ANTIKTCLUSTERER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+
+namespace o2::analysis::hadrex
+{
+
+class AntiKtClusterer
+{
+ public:
+  struct Jet {
+    float pt;
+    float eta;
+    float phi;
+    int nConstituents;
+  };
+
+  /// R below 2pi/3, so that three azimuthal tiles are at least R wide
+  void setRadius(double radius)
+  {
+    if (!(radius > 0. && radius < 2. * M_PI / 3.)) {
+      throw std::invalid_argument("AntiKtClusterer: radius must be in (0, 2pi/3)");
+    }
+    mR2 = radius * radius;
+    mRadius = radius;
+  }
+
+  /// Mass given to every particle, the pion mass as in the O2Physics jet finder
+  void setParticleMass(double mass) { mMass = mass; }
+
+  /// Clusters the particles; the jets are returned in decreasing pT
+  std::vector<Jet> const& cluster(const float* pt, const float* eta, const float* phi, std::size_t n)
+  {
+    load(pt, eta, phi, n);
+    mJets.clear();
+    if (n == 0) {
+      return mJets;
+    }
+    buildTiles();
+    for (std::size_t i = 0; i < n; ++i) {
+      findNeighbour(i);
+      push(i);
+    }
+
+    while (!mHeap.empty()) {
+      auto [distance, i, version] = mHeap.top();
+      mHeap.pop();
+      if (!mActive[i] || version != mVersion[i]) {
+        continue;
+      }
+      if (mNeighbour[i] < 0) {
+        addJet(i);
+        mActive[i] = false;
+        removeFromTile(i);
+        continue;
+      }
+
+      // merge the neighbour j into i, then update the particles whose
+      // neighbour may have changed: they all are around the old tiles of i
+      // and j or the new tile of i
+      const int j = mNeighbour[i];
+      const int oldTileI = mTile[i];
+      const int tileJ = mTile[j];
+      mActive[j] = false;
+      removeFromTile(j);
+      mPx[i] += mPx[j];
+      mPy[i] += mPy[j];
+      mPz[i] += mPz[j];
+      mE[i] += mE[j];
+      mNConstituents[i] += mNConstituents[j];
+      updateKinematics(i);
+      const int newTileI = tileOf(i);
+      if (newTileI != oldTileI) {
+        removeFromTile(i);
+        addToTile(i, newTileI);
+      }
+
+      ++mVisit;
+      for (int tile : {oldTileI, tileJ, newTileI}) {
+        for (int neighbourTile : mTileNeighbours[tile]) {
+          if (mTileVisit[neighbourTile] == mVisit) {
+            continue;
+          }
+          mTileVisit[neighbourTile] = mVisit;
+          for (int k : mTileMembers[neighbourTile]) {
+            if (k == i) {
+              continue;
+            }
+            if (mNeighbour[k] == i || mNeighbour[k] == j) {
+              findNeighbour(k);
+              push(k);
+            } else {
+              double d = distance2(i, k);
+              if (d < mNeighbourDistance[k]) {
+                mNeighbour[k] = i;
+                mNeighbourDistance[k] = d;
+                push(k);
+              }
+            }
+          }
+        }
+      }
+      findNeighbour(i);
+      push(i);
+    }
+    sortJets();
+    return mJets;
+  }
+
+  /// Same clustering with a full search of the smallest distance at every step
+  std::vector<Jet> const& clusterNaive(const float* pt, const float* eta, const float* phi, std::size_t n)
+  {
+    load(pt, eta, phi, n);
+    mJets.clear();
+    std::size_t nActive = n;
+    while (nActive > 0) {
+      double best = INFINITY;
+      int bestI = -1, bestJ = -1;
+      for (std::size_t i = 0; i < n; ++i) {
+        if (!mActive[i]) {
+          continue;
+        }
+        if (mKt2Inv[i] < best) {
+          best = mKt2Inv[i];
+          bestI = i;
+          bestJ = -1;
+        }
+        for (std::size_t j = i + 1; j < n; ++j) {
+          if (!mActive[j]) {
+            continue;
+          }
+          double d = std::min(mKt2Inv[i], mKt2Inv[j]) * distance2(i, j) / mR2;
+          if (d < best) {
+            best = d;
+            bestI = i;
+            bestJ = j;
+          }
+        }
+      }
+      if (bestJ < 0) {
+        addJet(bestI);
+        mActive[bestI] = false;
+      } else {
+        mPx[bestI] += mPx[bestJ];
+        mPy[bestI] += mPy[bestJ];
+        mPz[bestI] += mPz[bestJ];
+        mE[bestI] += mE[bestJ];
+        mNConstituents[bestI] += mNConstituents[bestJ];
+        updateKinematics(bestI);
+        mActive[bestJ] = false;
+      }
+      --nActive;
+    }
+    sortJets();
+    return mJets;
+  }
+
+ private:
+  struct HeapEntry {
+    double distance;
+    int index;
+    uint32_t version;
+    bool operator>(HeapEntry const& other) const { return distance > other.distance; }
+  };
+
+  void load(const float* pt, const float* eta, const float* phi, std::size_t n)
+  {
+    for (auto* v : {&mPx, &mPy, &mPz, &mE, &mY, &mPhi, &mKt2Inv, &mNeighbourDistance}) {
+      v->resize(n);
+    }
+    mNeighbour.assign(n, -1);
+    mNConstituents.assign(n, 1);
+    mActive.assign(n, true);
+    mVersion.assign(n, 0);
+    mTile.assign(n, -1);
+    mPositionInTile.assign(n, -1);
+    for (std::size_t i = 0; i < n; ++i) {
+      mPx[i] = pt[i] * std::cos(phi[i]);
+      mPy[i] = pt[i] * std::sin(phi[i]);
+      mPz[i] = pt[i] * std::sinh(eta[i]);
+      mE[i] = std::sqrt(mPx[i] * mPx[i] + mPy[i] * mPy[i] + mPz[i] * mPz[i] + mMass * mMass);
+      updateKinematics(i);
+    }
+  }
+
+  void updateKinematics(int i)
+  {
+    const double pt2 = mPx[i] * mPx[i] + mPy[i] * mPy[i];
+    mKt2Inv[i] = pt2 > 0. ? 1. / pt2 : INFINITY;
+    double phi = std::atan2(mPy[i], mPx[i]);
+    mPhi[i] = phi < 0. ? phi + 2. * M_PI : phi;
+    // rapidity, with the FastJet convention for particles along the beam
+    const double eMinusPz = mE[i] - mPz[i];
+    const double ePlusPz = mE[i] + mPz[i];
+    constexpr double maxRapidity = 1e5;
+    mY[i] = eMinusPz > 0. && ePlusPz > 0. ? 0.5 * std::log(ePlusPz / eMinusPz) : (mPz[i] > 0. ? maxRapidity : -maxRapidity);
+  }
+
+  double distance2(int i, int j) const
+  {
+    double dPhi = std::abs(mPhi[i] - mPhi[j]);
+    dPhi = dPhi > M_PI ? 2. * M_PI - dPhi : dPhi;
+    const double dY = mY[i] - mY[j];
+    return dY * dY + dPhi * dPhi;
+  }
+
+  void buildTiles()
+  {
+    auto [yMinIt, yMaxIt] = std::minmax_element(mY.begin(), mY.end());
+    mYMin = *yMinIt;
+    const double yRange = *yMaxIt - mYMin;
+    mNYTiles = std::max(1, static_cast<int>(yRange / mRadius));
+    mYTileInvWidth = yRange > 0. ? mNYTiles / yRange : 0.;
+    mNPhiTiles = std::max(3, static_cast<int>(2. * M_PI / mRadius));
+    mPhiTileInvWidth = mNPhiTiles / (2. * M_PI);
+    const int nTiles = mNYTiles * mNPhiTiles;
+    mTileMembers.assign(nTiles, {});
+    mTileVisit.assign(nTiles, 0);
+    mVisit = 0;
+    mTileNeighbours.assign(nTiles, {});
+    for (int iy = 0; iy < mNYTiles; ++iy) {
+      for (int iphi = 0; iphi < mNPhiTiles; ++iphi) {
+        auto& neighbours = mTileNeighbours[iy * mNPhiTiles + iphi];
+        for (int dy = -1; dy <= 1; ++dy) {
+          if (iy + dy < 0 || iy + dy >= mNYTiles) {
+            continue;
+          }
+          for (int dphi = -1; dphi <= 1; ++dphi) {
+            neighbours.push_back((iy + dy) * mNPhiTiles + (iphi + dphi + mNPhiTiles) % mNPhiTiles);
+          }
+        }
+      }
+    }
+    for (std::size_t i = 0; i < mY.size(); ++i) {
+      addToTile(i, tileOf(i));
+    }
+  }
+
+  int tileOf(int i) const
+  {
+    const int iy = std::min(std::max(static_cast<int>((mY[i] - mYMin) * mYTileInvWidth), 0), mNYTiles - 1);
+    const int iphi = std::min(static_cast<int>(mPhi[i] * mPhiTileInvWidth), mNPhiTiles - 1);
+    return iy * mNPhiTiles + iphi;
+  }
+
+  void addToTile(int i, int tile)
+  {
+    mTile[i] = tile;
+    mPositionInTile[i] = mTileMembers[tile].size();
+    mTileMembers[tile].push_back(i);
+  }
+
+  void removeFromTile(int i)
+  {
+    auto& members = mTileMembers[mTile[i]];
+    const int last = members.back();
+    members[mPositionInTile[i]] = last;
+    mPositionInTile[last] = mPositionInTile[i];
+    members.pop_back();
+    mTile[i] = -1;
+  }
+
+  /// Geometric nearest neighbour within R, in the surrounding tiles
+  void findNeighbour(int i)
+  {
+    mNeighbour[i] = -1;
+    mNeighbourDistance[i] = mR2;
+    for (int tile : mTileNeighbours[mTile[i]]) {
+      for (int k : mTileMembers[tile]) {
+        if (k == i) {
+          continue;
+        }
+        const double d = distance2(i, k);
+        if (d < mNeighbourDistance[i]) {
+          mNeighbourDistance[i] = d;
+          mNeighbour[i] = k;
+        }
+      }
+    }
+  }
+
+  /// The smallest d_ij = min(1/kt_i^2, 1/kt_j^2) dR_ij^2 / R^2 is between a
+  /// particle and its geometric nearest neighbour, so each particle enters
+  /// the heap with 1/kt^2 x (dR^2 to its neighbour, or R^2 for the beam)
+  void push(int i)
+  {
+    const int j = mNeighbour[i];
+    const double kt2Inv = j >= 0 ? std::min(mKt2Inv[i], mKt2Inv[j]) : mKt2Inv[i];
+    mHeap.push({kt2Inv * mNeighbourDistance[i] / mR2, i, ++mVersion[i]});
+  }
+
+  void addJet(int i)
+  {
+    const double pt = std::hypot(mPx[i], mPy[i]);
+    const double eta = pt > 0. ? std::asinh(mPz[i] / pt) : (mPz[i] > 0. ? INFINITY : -INFINITY);
+    mJets.push_back({static_cast<float>(pt), static_cast<float>(eta), static_cast<float>(mPhi[i]), mNConstituents[i]});
+  }
+
+  void sortJets()
+  {
+    std::sort(mJets.begin(), mJets.end(), [](Jet const& a, Jet const& b) { return a.pt > b.pt; });
+  }
+
+  double mRadius = 0.4;
+  double mR2 = 0.16;
+  double mMass = 0.13957;
+
+  // particles and pseudojets, a merged pseudojet takes the slot of one of its parts
+  std::vector<double> mPx, mPy, mPz, mE, mY, mPhi, mKt2Inv;
+  std::vector<int> mNConstituents;
+  std::vector<char> mActive;
+  std::vector<int> mNeighbour;
+  std::vector<double> mNeighbourDistance;
+  std::vector<uint32_t> mVersion;
+
+  // tiles at least R wide in rapidity and azimuth
+  double mYMin = 0.;
+  double mYTileInvWidth = 0.;
+  double mPhiTileInvWidth = 0.;
+  int mNYTiles = 1;
+  int mNPhiTiles = 3;
+  std::vector<int> mTile;
+  std::vector<int> mPositionInTile;
+  std::vector<std::vector<int>> mTileMembers;
+  std::vector<std::vector<int>> mTileNeighbours;
+  std::vector<uint32_t> mTileVisit;
+  uint32_t mVisit = 0;
+
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> mHeap;
+  std::vector<Jet> mJets;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // JETS_ANTIKTCLUSTERER_H_
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+# See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+# All rights not expressly granted are reserved.
+#
+# This software is distributed under the terms of the GNU General Public
+# License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+#
+# In applying this license CERN does not waive the privileges and immunities
+# granted to it by virtue of its status as an Intergovernmental Organization
+# or submit itself to any jurisdiction.
+
+"""Compares the jet pT spectrum of run-jet-spectra.sh with the one of run-jet-tasks.sh.
+
+The reference is the AnalysisResults.root of the je-jet-finder ->
+jet-task-skim-provider -> jetspectra-task-skim-analyser chain, the test the
+one of the jetspectra task. Both run on the same input, so the spectra are
+compared bin by bin above --pt-min: the script prints the integrals, the
+bins with the largest differences and chi2/ndf = sum (r - t)^2 / (r + t),
+and exits with 1 when chi2/ndf is above --max-chi2.
+
+The histograms are given by path (--reference-histogram, default
+jetspectra-task-skim-analyser/hJetPt, and --test-histogram, default
+jetspectra/jetPt); the script stops when one of them is not in its file.
+
+With --benchmark, the wall time and peak RSS of the jet-tasks and
+jet-spectra workflows are taken from a Benchmark/benchmark-workflows.py
+result file.
+
+Example:
+  ./Benchmark/benchmark-workflows.py -o jets.json jet-tasks jet-spectra
+  ./Jets/compare-jet-spectra.py benchmark-runs/jet-tasks/0/AnalysisResults.root \\
+      benchmark-runs/jet-spectra/0/AnalysisResults.root --benchmark jets.json
+"""
+
+import argparse
+import importlib.util
+import json
+import os
+import sys
+
+REPO_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+REFERENCE_HISTOGRAM = "jetspectra-task-skim-analyser/hJetPt"
+TEST_HISTOGRAM = "jetspectra/jetPt"
+
+
+def load_benchmark_module():
+    spec = importlib.util.spec_from_file_location("benchmark_workflows", os.path.join(REPO_DIR, "Benchmark", "benchmark-workflows.py"))
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def missing_histogram(results, histogram):
+    """Error message if the histogram is not in the file, with the histograms of its directory"""
+    paths = results.histogram_paths()
+    if histogram in paths:
+        return None
+    directory = histogram.split("/")[0]
+    candidates = ", ".join(path for path in paths if path.startswith(directory + "/")) or "none"
+    return f"no histogram {histogram} in {results.path} (histograms in {directory}/: {candidates})"
+
+
+def compare_spectra(reference, test, reference_edges, test_edges, pt_min):
+    """chi2, ndf and the per-bin (low edge, reference, test) above pt_min"""
+    if len(reference_edges) != len(test_edges) or any(abs(a - b) > 1e-6 for a, b in zip(reference_edges, test_edges)):
+        raise ValueError("the two histograms have different binnings")
+    bins = [(reference_edges[i], r, t) for i, (r, t) in enumerate(zip(reference, test)) if reference_edges[i] >= pt_min - 1e-6]
+    chi2 = sum((r - t) ** 2 / (r + t) for _, r, t in bins if r + t > 0)
+    ndf = sum(1 for _, r, t in bins if r + t > 0)
+    return chi2, ndf, bins
+
+
+def print_throughput(benchmark_file):
+    with open(benchmark_file) as f:
+        summaries = json.load(f)
+    for name in ("jet-tasks", "jet-spectra"):
+        summary = summaries.get(name)
+        if summary is None:
+            print(f"{name}: not in {benchmark_file}")
+            continue
+        rss = [peaks["peakRss"] for peaks in summary["devices"].values() if peaks.get("peakRss") is not None]
+        line = f"{name:12} wall {summary['wallTime']:8.1f} s"
+        if summary.get("eventsPerSecond"):
+            line += f", {summary['eventsPerSecond']:.1f} events/s"
+        if rss:
+            line += f", summed peak RSS {sum(rss):.4g}, devices {len(summary['devices'])}"
+        print(line)
+    if "jet-tasks" in summaries and "jet-spectra" in summaries and summaries["jet-spectra"]["wallTime"]:
+        print(f"wall time ratio jet-tasks / jet-spectra: {summaries['jet-tasks']['wallTime'] / summaries['jet-spectra']['wallTime']:.2f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("reference", help="AnalysisResults.root of run-jet-tasks.sh")
+    parser.add_argument("test", help="AnalysisResults.root of run-jet-spectra.sh")
+    parser.add_argument("--reference-histogram", default=REFERENCE_HISTOGRAM, help=f"jet pT histogram of the reference (default: {REFERENCE_HISTOGRAM})")
+    parser.add_argument("--test-histogram", default=TEST_HISTOGRAM, help=f"jet pT histogram of the test (default: {TEST_HISTOGRAM})")
+    parser.add_argument("--pt-min", type=float, default=10.0, help="lowest jet pT compared (jetPtMin of the jet finder)")
+    parser.add_argument("--max-chi2", type=float, default=1.0, help="largest accepted chi2/ndf")
+    parser.add_argument("--benchmark", help="benchmark-workflows.py result file with the jet-tasks and jet-spectra workflows")
+    args = parser.parse_args()
+
+    benchmark = load_benchmark_module()
+    reference = benchmark.ResultsFile(args.reference)
+    test = benchmark.ResultsFile(args.test)
+    reference_histogram = args.reference_histogram
+    for results, histogram, option in ((reference, reference_histogram, "--reference-histogram"), (test, args.test_histogram, "--test-histogram")):
+        error = missing_histogram(results, histogram)
+        if error:
+            parser.error(f"{error}, give {option}")
+
+    chi2, ndf, bins = compare_spectra(
+        reference.bin_contents(reference_histogram),
+        test.bin_contents(args.test_histogram),
+        reference.bin_edges(reference_histogram),
+        test.bin_edges(args.test_histogram),
+        args.pt_min,
+    )
+    reference_integral = sum(r for _, r, _ in bins)
+    test_integral = sum(t for _, _, t in bins)
+    print(f"reference {args.reference}:{reference_histogram}, {reference_integral:.0f} jets above {args.pt_min} GeV/c")
+    print(f"test      {args.test}:{args.test_histogram}, {test_integral:.0f} jets above {args.pt_min} GeV/c")
+    worst = sorted((b for b in bins if b[1] != b[2]), key=lambda b: abs(b[1] - b[2]), reverse=True)[:5]
+    for low_edge, r, t in worst:
+        print(f"  pT > {low_edge:6.1f}: reference {r:8.0f}  test {t:8.0f}  ratio {t / r if r else float('inf'):.3f}")
+    print(f"chi2/ndf = {chi2:.2f}/{ndf}")
+
+    if args.benchmark:
+        print_throughput(args.benchmark)
+
+    if ndf and chi2 / ndf > args.max_chi2:
+        print(f"DIFFERENT: chi2/ndf above {args.max_chi2}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,148 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \brief Charged-jet pT spectrum with the anti-kT clustering done in the task,
+///        replacing the je-jet-finder -> jet-task-skim-provider ->
+///        jetspectra-task-skim-analyser chain of run-jet-tasks.sh. The event
+///        and track selections follow the jet finder configuration of
+///        dpl-config-jets.json.
+/// \author
+/// \since
+
+#include "Framework/runDataProcessing.h"
+#include "Framework/AnalysisTask.h"
+#include "Common/DataModel/EventSelection.h"
+#include "Common/DataModel/TrackSelectionTables.h"
+#include "AntiKtClusterer.h"
+#include "../ProcessProfiler.h"
+
+using namespace o2;
+using namespace o2::framework;
+using namespace o2::framework::expressions;
+using namespace o2::analysis::hadrex;
+
+struct jetspectra {
+  Configurable<float> vertexZCut{"vertexZCut", 10.0f, "Accepted z-vertex range"};
+  Configurable<float> trackPtCut{"trackPtCut", 0.1f, "Minimum constituent pT"};
+  Configurable<float> trackEtaCut{"trackEtaCut", 0.9f, "Maximum constituent |eta|"};
+  Configurable<bool> requireSel8{"requireSel8", true, "Require the sel8 event selection"};
+  Configurable<bool> requireGlobalTrack{"requireGlobalTrack", true, "Require global tracks as constituents"};
+  Configurable<float> jetR{"jetR", 0.4f, "Jet resolution parameter"};
+  Configurable<float> jetPtMin{"jetPtMin", 10.0f, "Minimum jet pT"};
+  Configurable<bool> validateClusterer{"validateClusterer", false, "Compare the tiled clustering with the naive O(N^3) one, jet by jet"};
+
+  Filter collisionFilter = nabs(aod::collision::posZ) < vertexZCut;
+  Filter trackFilter = aod::track::pt >= trackPtCut && nabs(aod::track::eta) < trackEtaCut;
+  using SelectedCollisions = soa::Filtered<soa::Join<aod::Collisions, aod::EvSels>>;
+  using SelectedTracks = soa::Filtered<soa::Join<aod::Tracks, aod::TrackSelection>>;
+
+  HistogramRegistry registry{"registry", {}};
+
+  //Constituents of one collision, as contiguous arrays
+  std::vector<float> constituentPt, constituentEta, constituentPhi;
+  AntiKtClusterer clusterer;
+
+  //Per-process timing and row counters (rows out are jets above jetPtMin)
+  ProcessProfiler profiler;
+
+  void init(InitContext const&)
+  {
+    registry.add("hVertexZ", "hVertexZ", {HistType::kTH1F, {{100, -15., 15.}}});
+    registry.add("hNConstituents", "selected tracks per collision", {HistType::kTH1F, {{200, -0.5, 199.5}}});
+    registry.add("jetPt", "charged jet #it{p}_{T};#it{p}_{T} (GeV/#it{c})", {HistType::kTH1F, {{200, 0., 200.}}});
+    registry.add("jetEta", "charged jet #eta;#eta", {HistType::kTH1F, {{100, -1., 1.}}});
+    registry.add("jetPhi", "charged jet #varphi;#varphi", {HistType::kTH1F, {{100, 0., 2. * M_PI}}});
+    registry.add("jetNConstituents", "constituents per jet;N", {HistType::kTH1F, {{100, -0.5, 99.5}}});
+    registry.add("hNJets", "jets per collision;N", {HistType::kTH1F, {{20, -0.5, 19.5}}});
+    if (validateClusterer) {
+      auto hValidation = registry.add<TH1>("hClustererValidation", "hClustererValidation", {HistType::kTH1D, {{3, -0.5, 2.5}}});
+      hValidation->GetXaxis()->SetBinLabel(1, "collisions compared");
+      hValidation->GetXaxis()->SetBinLabel(2, "jets compared");
+      hValidation->GetXaxis()->SetBinLabel(3, "jets mismatched");
+    }
+    clusterer.setRadius(jetR);
+    profiler.init(registry, {"process"});
+  }
+
+  void endOfStream(EndOfStreamContext&)
+  {
+    profiler.write();
+  }
+
+  //Counts the jets of the naive clustering that differ from the tiled ones;
+  //a different number of jets counts all of them as mismatched
+  void validate(std::vector<AntiKtClusterer::Jet> const& jets)
+  {
+    std::vector<AntiKtClusterer::Jet> tiled = jets;
+    auto const& naive = clusterer.clusterNaive(constituentPt.data(), constituentEta.data(), constituentPhi.data(), constituentPt.size());
+    int nMismatched = 0;
+    if (naive.size() != tiled.size()) {
+      nMismatched = std::max(naive.size(), tiled.size());
+    } else {
+      for (std::size_t i = 0; i < naive.size(); ++i) {
+        if (std::abs(naive[i].pt - tiled[i].pt) > 1e-5f * naive[i].pt || std::abs(naive[i].eta - tiled[i].eta) > 1e-5f ||
+            std::abs(naive[i].phi - tiled[i].phi) > 1e-5f || naive[i].nConstituents != tiled[i].nConstituents) {
+          nMismatched++;
+        }
+      }
+    }
+    auto hValidation = registry.get<TH1>(HIST("hClustererValidation"));
+    hValidation->Fill(0.);
+    hValidation->Fill(1., static_cast<double>(naive.size()));
+    hValidation->Fill(2., nMismatched);
+  }
+
+  void process(SelectedCollisions::iterator const& collision, SelectedTracks const& tracks)
+  {
+    auto profile = profiler.measure(0, tracks.size());
+    if (requireSel8 && !collision.sel8()) {
+      return;
+    }
+    registry.fill(HIST("hVertexZ"), collision.posZ());
+
+    constituentPt.clear();
+    constituentEta.clear();
+    constituentPhi.clear();
+    for (auto& track : tracks) {
+      if (requireGlobalTrack && !track.isGlobalTrack()) continue;
+      constituentPt.push_back(track.pt());
+      constituentEta.push_back(track.eta());
+      constituentPhi.push_back(track.phi());
+    }
+    registry.fill(HIST("hNConstituents"), constituentPt.size());
+
+    auto const& jets = clusterer.cluster(constituentPt.data(), constituentEta.data(), constituentPhi.data(), constituentPt.size());
+    int nJets = 0;
+    for (auto const& jet : jets) {
+      if (jet.pt < jetPtMin) {
+        break; // sorted in decreasing pT
+      }
+      registry.fill(HIST("jetPt"), jet.pt);
+      registry.fill(HIST("jetEta"), jet.eta);
+      registry.fill(HIST("jetPhi"), jet.phi);
+      registry.fill(HIST("jetNConstituents"), jet.nConstituents);
+      nJets++;
+    }
+    registry.fill(HIST("hNJets"), nJets);
+    profile.addRowsOut(nJets);
+
+    if (validateClusterer) {
+      validate(jets);
+    }
+  }
+};
+
+WorkflowSpec defineDataProcessing(ConfigContext const& cfgc)
+{
+  return WorkflowSpec{
+    adaptAnalysisTask<jetspectra>(cfgc)
+  };
+}
@@ -0,0 +1,7 @@
+export OPT="-b --configuration json://${HADREX_DPL_CONFIG:-dpl-config-jets.json} --resources-monitoring 2 ${HADREX_EXTRA_OPT}"
+o2-analysistutorial-jet-spectra ${OPT} | \
+o2-analysis-collision-converter ${OPT} | \
+o2-analysis-timestamp ${OPT} | \
+o2-analysis-track-propagation ${OPT} | \
+o2-analysis-trackselection ${OPT} | \
+o2-analysis-event-selection ${OPT}
@@ -1,4 +1,4 @@
-export OPT="-b --configuration json://dpl-config-jets.json"
+export OPT="-b --configuration json://${HADREX_DPL_CONFIG:-dpl-config-jets.json} --resources-monitoring 2 ${HADREX_EXTRA_OPT}"
 o2-analysistutorial-jetspectra-task-skim-analyser ${OPT} | \
 o2-analysistutorial-jet-task-skim-provider ${OPT} | \
 o2-analysis-collision-converter ${OPT} | \
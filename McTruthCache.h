@@ -0,0 +1,89 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file McTruthCache.h
+/// \brief Dense per-dataframe copy of the McParticles columns needed for
+///        truth matching (PDG code, pT, first mother). Built with one
+///        sequential scan, then looked up through the MC label index,
+///        one label at a time or in batches.
+/// \author
+/// \since
+
+#ifndef MCTRUTHCACHE_H_
+#define MCTRUTHCACHE_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace o2::analysis::hadrex
+{
+
+class McTruthCache
+{
+ public:
+  /// To be called when a new dataframe starts, e.g. in the run() of the task
+  void invalidate() { mValid = false; }
+
+  /// Builds the arrays from the McParticles table if they are not valid
+  template <typename TMcParticles>
+  void update(TMcParticles const& mcParticles)
+  {
+    if (mValid) {
+      return;
+    }
+    const auto n = mcParticles.size();
+    mPdgCode.resize(n);
+    mPt.resize(n);
+    mMotherId.resize(n);
+    int64_t i = 0;
+    for (auto const& particle : mcParticles) {
+      mPdgCode[i] = particle.pdgCode();
+      mPt[i] = particle.pt();
+      auto mothers = particle.mothersIds();
+      mMotherId[i] = mothers.empty() ? -1 : mothers[0];
+      ++i;
+    }
+    mValid = true;
+  }
+
+  bool valid() const { return mValid; }
+  int32_t pdgCode(int32_t label) const { return mPdgCode[label]; }
+  float pt(int32_t label) const { return mPt[label]; }
+  int32_t motherId(int32_t label) const { return mMotherId[label]; }
+
+  /// Batch lookups; negative labels (no MC particle) give PDG code 0,
+  /// pT -1 and mother -1
+  void gatherPdgCode(const int32_t* labels, std::size_t n, int32_t* out) const { gather(mPdgCode, labels, n, out, 0); }
+  void gatherPt(const int32_t* labels, std::size_t n, float* out) const { gather(mPt, labels, n, out, -1.f); }
+  void gatherMotherId(const int32_t* labels, std::size_t n, int32_t* out) const { gather(mMotherId, labels, n, out, -1); }
+
+ private:
+  template <typename T>
+  static void gather(std::vector<T> const& column, const int32_t* labels, std::size_t n, T* out, T missing)
+  {
+    constexpr std::size_t prefetchDistance = 8;
+    for (std::size_t i = 0; i < n; ++i) {
+      if (i + prefetchDistance < n && labels[i + prefetchDistance] >= 0) {
+        __builtin_prefetch(&column[labels[i + prefetchDistance]]);
+      }
+      out[i] = labels[i] >= 0 ? column[labels[i]] : missing;
+    }
+  }
+
+  bool mValid = false;
+  std::vector<int32_t> mPdgCode;
+  std::vector<float> mPt;
+  std::vector<int32_t> mMotherId;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // MCTRUTHCACHE_H_
@@ -0,0 +1,101 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file MixedEventPool.h
+/// \brief Fixed-capacity event pool for same-pass event mixing.
+///        Events are binned in vertex z and multiplicity and every bin keeps
+///        a ring buffer of the associated particles of the last `depth`
+///        events, stored as compact float arrays (the triggers of the current
+///        event are mixed with them, pooled triggers are never read).
+///        Memory is bounded by nBinsVtxZ x nBinsMult x depth events.
+/// \author
+/// \since
+
+#ifndef MIXEDEVENTPOOL_H_
+#define MIXEDEVENTPOOL_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "CorrelationEngine.h"
+
+namespace o2::analysis::hadrex
+{
+
+class MixedEventPool
+{
+ public:
+  /// Bin edges are given as increasing lists, events outside them are not pooled
+  void setBinning(std::vector<float> const& vtxZEdges, std::vector<float> const& multEdges, int depth)
+  {
+    mVtxZEdges = vtxZEdges;
+    mMultEdges = multEdges;
+    mDepth = std::max(depth, 1);
+    int nBins = std::max<int>(mVtxZEdges.size() - 1, 0) * std::max<int>(mMultEdges.size() - 1, 0);
+    mEvents.assign(nBins * mDepth, ParticleArrays{});
+    mFilled.assign(nBins, 0);
+    mNext.assign(nBins, 0);
+  }
+
+  /// Returns the pool bin of an event or -1 if it is outside the binning
+  int findBin(float posZ, float multiplicity) const
+  {
+    int iZ = findEdge(mVtxZEdges, posZ);
+    int iMult = findEdge(mMultEdges, multiplicity);
+    if (iZ < 0 || iMult < 0) {
+      return -1;
+    }
+    return iZ * (mMultEdges.size() - 1) + iMult;
+  }
+
+  /// Calls f(ParticleArrays const& associates) for all events currently stored in a bin
+  template <typename F>
+  void forEachEvent(int bin, F&& f) const
+  {
+    for (int slot = 0; slot < mFilled[bin]; ++slot) {
+      f(mEvents[bin * mDepth + slot]);
+    }
+  }
+
+  int nEvents(int bin) const { return mFilled[bin]; }
+
+  /// Copies the associates of an event into the bin, overwriting the oldest
+  /// event once the bin is full. The slot vectors keep their capacity, so a
+  /// warm pool does not allocate.
+  void push(int bin, ParticleArrays const& associates)
+  {
+    auto& event = mEvents[bin * mDepth + mNext[bin]];
+    event.phi.assign(associates.phi.begin(), associates.phi.end());
+    event.eta.assign(associates.eta.begin(), associates.eta.end());
+    mNext[bin] = (mNext[bin] + 1) % mDepth;
+    mFilled[bin] = std::min(mFilled[bin] + 1, mDepth);
+  }
+
+ private:
+  static int findEdge(std::vector<float> const& edges, float value)
+  {
+    if (edges.size() < 2 || value < edges.front() || !(value < edges.back())) {
+      return -1;
+    }
+    return std::upper_bound(edges.begin(), edges.end(), value) - edges.begin() - 1;
+  }
+
+  int mDepth = 1;
+  std::vector<float> mVtxZEdges;
+  std::vector<float> mMultEdges;
+  std::vector<ParticleArrays> mEvents; // associates, nBins x depth slots
+  std::vector<int> mFilled;            // events stored per bin
+  std::vector<int> mNext;              // next slot to overwrite per bin
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // MIXEDEVENTPOOL_H_
@@ -0,0 +1,140 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file ProcessProfiler.h
+/// \brief Low-overhead instrumentation of the process functions of a task.
+///        Wall and CPU time, invocations and rows in/out are accumulated in
+///        plain counters owned by the task (i.e. by the device processing
+///        thread, no synchronisation) and written once, at end of stream,
+///        into "profiling/<process>" histograms of the task registry.
+/// \author
+/// \since
+
+#ifndef PROCESSPROFILER_H_
+#define PROCESSPROFILER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Framework/HistogramRegistry.h"
+
+namespace o2::analysis::hadrex
+{
+
+class ProcessProfiler
+{
+ public:
+  enum Quantity : int {
+    kCalls = 1,
+    kWallTime,
+    kCpuTime,
+    kRowsIn,
+    kRowsOut,
+    kRowsInRate,
+    kRowsOutRate,
+    kNQuantities = kRowsOutRate
+  };
+
+  struct Counters {
+    uint64_t calls = 0;
+    uint64_t rowsIn = 0;
+    uint64_t rowsOut = 0;
+    int64_t wallNs = 0;
+    int64_t cpuNs = 0;
+  };
+
+  /// Measures one invocation from construction to destruction
+  class Scope
+  {
+   public:
+    Scope(Counters& counters, uint64_t rowsIn) : mCounters(counters), mWallStart(wallNow()), mCpuStart(cpuNow())
+    {
+      mCounters.calls++;
+      mCounters.rowsIn += rowsIn;
+    }
+    ~Scope()
+    {
+      mCounters.wallNs += wallNow() - mWallStart;
+      mCounters.cpuNs += cpuNow() - mCpuStart;
+    }
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+    void addRowsOut(uint64_t rows) { mCounters.rowsOut += rows; }
+
+   private:
+    Counters& mCounters;
+    int64_t mWallStart;
+    int64_t mCpuStart;
+  };
+
+  /// Books one histogram per profiled process function, to be called in init()
+  void init(o2::framework::HistogramRegistry& registry, std::vector<std::string> const& processNames)
+  {
+    mCounters.assign(processNames.size(), Counters{});
+    mHistograms.clear();
+    for (auto const& name : processNames) {
+      auto hist = registry.add<TH1>(("profiling/" + name).c_str(), (name + ";;").c_str(), {o2::framework::HistType::kTH1D, {{kNQuantities, 0.5, kNQuantities + 0.5}}});
+      hist->GetXaxis()->SetBinLabel(kCalls, "calls");
+      hist->GetXaxis()->SetBinLabel(kWallTime, "wall time (s)");
+      hist->GetXaxis()->SetBinLabel(kCpuTime, "cpu time (s)");
+      hist->GetXaxis()->SetBinLabel(kRowsIn, "rows in");
+      hist->GetXaxis()->SetBinLabel(kRowsOut, "rows out");
+      hist->GetXaxis()->SetBinLabel(kRowsInRate, "rows in / s");
+      hist->GetXaxis()->SetBinLabel(kRowsOutRate, "rows out / s");
+      mHistograms.push_back(hist);
+    }
+  }
+
+  Scope measure(int process, uint64_t rowsIn) { return Scope(mCounters[process], rowsIn); }
+
+  Counters const& counters(int process) const { return mCounters[process]; }
+
+  /// Copies the counters into the histograms, to be called in endOfStream()
+  void write()
+  {
+    for (std::size_t i = 0; i < mCounters.size(); ++i) {
+      auto const& c = mCounters[i];
+      auto& hist = mHistograms[i];
+      double wall = c.wallNs * 1e-9;
+      hist->SetBinContent(kCalls, c.calls);
+      hist->SetBinContent(kWallTime, wall);
+      hist->SetBinContent(kCpuTime, c.cpuNs * 1e-9);
+      hist->SetBinContent(kRowsIn, c.rowsIn);
+      hist->SetBinContent(kRowsOut, c.rowsOut);
+      hist->SetBinContent(kRowsInRate, wall > 0. ? c.rowsIn / wall : 0.);
+      hist->SetBinContent(kRowsOutRate, wall > 0. ? c.rowsOut / wall : 0.);
+    }
+  }
+
+ private:
+  static int64_t wallNow()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  static int64_t cpuNow()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+
+  std::vector<Counters> mCounters;
+  std::vector<std::shared_ptr<TH1>> mHistograms;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // PROCESSPROFILER_H_
@@ -0,0 +1,388 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file ReadDerivedTable.h
+/// \brief Task reading the derived D0 table and filling histograms,
+///        shared by the h4-3 (produce and read) and h4-final (read) workflows.
+///        Meant to be included by workflow files only.
+/// \author
+/// \since
+
+#ifndef READDERIVEDTABLE_H_
+#define READDERIVEDTABLE_H_
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "Framework/AnalysisTask.h"
+#include "Framework/HistogramRegistry.h"
+
+#include "ChunkScheduler.h"
+#include "ColumnCodec.h"
+#include "ColumnReader.h"
+#include "DerivedTables.h"
+#include "FillBuffer.h"
+#include "ProcessProfiler.h"
+
+using namespace o2;
+using namespace o2::framework;
+using namespace o2::analysis::hadrex;
+
+struct ReadDerivedTable { //<- workflow that reads derived table and fill
+                          // histograms
+
+  HistogramRegistry registry{"registry",
+                             {{"hMassD0", ";#it{M}(K#pi) (GeV/#it{c}^{2});counts", {HistType::kTH1F, {{300, 1.75, 2.05}}}},
+                              {"hMassD0bar", ";#it{M}(#piK) (GeV/#it{c}^{2});counts", {HistType::kTH1F, {{300, 1.75, 2.05}}}},
+                              {"hPt", ";#it{p}_{T} (GeV/#it{c});counts", {HistType::kTH1F, {{50, 0., 50.}}}},
+                              {"hCosp", ";cos(#vartheta_{P}) ;counts", {HistType::kTH1F, {{100, 0.8, 1.}}}}}};
+
+  // Optional pt and invariant mass windows. Rows outside them are not filled.
+  // The *Pruned process functions also skip the dataframes whose zone map
+  // excludes every row; they need MyZoneMaps, which derived AO2Ds written
+  // before the zone maps were introduced do not have.
+  // The mass window is passed by either the D0 or the D0bar hypothesis.
+  Configurable<bool> selectWindows{"selectWindows", false, "Apply the pt and mass windows"};
+  Configurable<float> ptWindowMin{"ptWindowMin", 0.f, "Lower edge of the pt window"};
+  Configurable<float> ptWindowMax{"ptWindowMax", 50.f, "Upper edge of the pt window"};
+  Configurable<float> massWindowMin{"massWindowMin", 1.75f, "Lower edge of the invariant mass window"};
+  Configurable<float> massWindowMax{"massWindowMax", 2.05f, "Upper edge of the invariant mass window"};
+
+  // per-process timing and row counters
+  ProcessProfiler profiler;
+
+  // the histograms are filled through buffers merged once per dataframe
+  FillBuffer1D massD0Buffer;
+  FillBuffer1D massD0barBuffer;
+  FillBuffer1D ptBuffer;
+  FillBuffer1D cospBuffer;
+
+  // Parallel read of MyTable: the rows of a dataframe are split in chunks
+  // shared by nReaderThreads workers, started in init and kept until the end
+  // of the stream. Each worker counts into its own shard
+  // and the shards are added to the histograms at the end of the stream.
+  // Bin counts are integers, so the result is the same as the serial read.
+  Configurable<int> nReaderThreads{"nReaderThreads", 1, "Worker threads reading MyTable in processStandard (1: serial)"};
+  Configurable<int> readerChunkSize{"readerChunkSize", 16384, "Rows per chunk of the parallel read"};
+
+  static constexpr int nColumns = 4; // invMassD0, invMassD0bar, pt, cosinePointing
+  struct ReaderShard {
+    std::array<BinnedCounts, nColumns> counts;
+    std::array<std::vector<float>, nColumns> selected;
+    std::vector<int> bins;
+  };
+  std::array<std::shared_ptr<TH1>, nColumns> histograms;
+  std::array<UniformBinning, nColumns> binnings;
+  std::vector<ReaderShard> shards;
+  std::unique_ptr<ChunkPool> readerPool;
+
+  void init(InitContext const&)
+  {
+    profiler.init(registry, {"processStandard", "processCompact", "processPerCollision", "processStandardPruned", "processCompactPruned", "processPerCollisionPruned"});
+    if ((doprocessStandard && doprocessStandardPruned) || (doprocessCompact && doprocessCompactPruned) || (doprocessPerCollision && doprocessPerCollisionPruned)) {
+      LOGF(fatal, "A process function and its Pruned variant read the same table, enable only one of them");
+    }
+    massD0Buffer.attach(registry.get<TH1>(HIST("hMassD0")));
+    massD0barBuffer.attach(registry.get<TH1>(HIST("hMassD0bar")));
+    ptBuffer.attach(registry.get<TH1>(HIST("hPt")));
+    cospBuffer.attach(registry.get<TH1>(HIST("hCosp")));
+
+    if (doprocessStandardPruned || doprocessCompactPruned || doprocessPerCollisionPruned) {
+      auto hDataframes = registry.add<TH1>("hDataframes", "zone map pruning", {HistType::kTH1D, {{3, 0.5, 3.5}}});
+      hDataframes->GetXaxis()->SetBinLabel(1, "dataframes");
+      hDataframes->GetXaxis()->SetBinLabel(2, "dataframes pruned");
+      hDataframes->GetXaxis()->SetBinLabel(3, "rows pruned");
+    }
+
+    if (doprocessPerCollision || doprocessPerCollisionPruned) {
+      registry.add("hNCandidates", ";candidates per collision;collisions", {HistType::kTH1F, {{20, 0.5, 20.5}}});
+      registry.add("hPtLeading", ";leading #it{p}_{T} (GeV/#it{c});collisions", {HistType::kTH1F, {{50, 0., 50.}}});
+    }
+
+    if (nReaderThreads > 1) {
+      if (readerChunkSize <= 0) {
+        LOGF(fatal, "readerChunkSize must be positive, got %d", readerChunkSize.value);
+      }
+      histograms = {registry.get<TH1>(HIST("hMassD0")), registry.get<TH1>(HIST("hMassD0bar")), registry.get<TH1>(HIST("hPt")), registry.get<TH1>(HIST("hCosp"))};
+      shards.resize(nReaderThreads);
+      readerPool = std::make_unique<ChunkPool>(nReaderThreads);
+      for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+        binnings[iColumn] = UniformBinning(histograms[iColumn]->GetXaxis());
+        for (auto& shard : shards) {
+          shard.counts[iColumn].setSize(binnings[iColumn].nBins + 2);
+        }
+      }
+    }
+  }
+
+  void endOfStream(EndOfStreamContext&)
+  {
+    // shards merged in worker order
+    for (auto& shard : shards) {
+      for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+        shard.counts[iColumn].mergeInto(histograms[iColumn].get());
+      }
+    }
+    readerPool.reset();
+    profiler.write();
+  }
+
+  void flushBuffers()
+  {
+    massD0Buffer.flush();
+    massD0barBuffer.flush();
+    ptBuffer.flush();
+    cospBuffer.flush();
+  }
+
+  bool inWindows(float pt, float invMassD0, float invMassD0bar) const
+  {
+    bool massInWindow = (invMassD0 >= massWindowMin && invMassD0 < massWindowMax) || (invMassD0bar >= massWindowMin && invMassD0bar < massWindowMax);
+    return !selectWindows || (pt >= ptWindowMin && pt < ptWindowMax && massInWindow);
+  }
+
+  // true if no row of this dataframe can pass the windows; a dataframe may
+  // hold several zone map rows when the writer merged several time frames
+  bool pruneDataframe(aod::MyZoneMaps const& zoneMaps, int64_t nRows)
+  {
+    registry.fill(HIST("hDataframes"), 1);
+    if (!selectWindows || zoneMaps.size() == 0) {
+      return false;
+    }
+    for (auto& zone : zoneMaps) {
+      bool ptOverlaps = zone.maxPt() >= ptWindowMin && zone.minPt() < ptWindowMax;
+      bool massD0Overlaps = zone.maxInvMassD0() >= massWindowMin && zone.minInvMassD0() < massWindowMax;
+      bool massD0barOverlaps = zone.maxInvMassD0bar() >= massWindowMin && zone.minInvMassD0bar() < massWindowMax;
+      if (zone.nRows() > 0 && ptOverlaps && (massD0Overlaps || massD0barOverlaps)) {
+        return false;
+      }
+    }
+    registry.fill(HIST("hDataframes"), 2);
+    registry.fill(HIST("hDataframes"), 3, nRows);
+    return true;
+  }
+
+  /// Bins the rows of one dataframe into the per-worker shards, returns the rows filled
+  uint64_t readParallel(aod::MyTable const& cand2Prongs)
+  {
+    auto table = cand2Prongs.asArrowTable();
+    const std::array<ColumnReader<float>, nColumns> columns{ColumnReader<float>{*table, "fInvMassD0"},
+                                                            ColumnReader<float>{*table, "fInvMassD0bar"},
+                                                            ColumnReader<float>{*table, "fPt"},
+                                                            ColumnReader<float>{*table, "fCosinePointing"}};
+    uint64_t entriesBefore = 0;
+    for (auto const& shard : shards) {
+      entriesBefore += shard.counts[0].entries();
+    }
+
+    readerPool->forEachChunk(cand2Prongs.size(), readerChunkSize, [&](int worker, int64_t begin, int64_t end) {
+      auto& shard = shards[worker];
+      std::array<const float*, nColumns> values;
+      for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+        values[iColumn] = columns[iColumn].data() + begin;
+      }
+      std::size_t n = end - begin;
+      if (selectWindows) {
+        for (auto& selected : shard.selected) {
+          selected.clear();
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+          if (inWindows(values[2][i], values[0][i], values[1][i])) {
+            for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+              shard.selected[iColumn].push_back(values[iColumn][i]);
+            }
+          }
+        }
+        n = shard.selected[0].size();
+        for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+          values[iColumn] = shard.selected[iColumn].data();
+        }
+      }
+      shard.bins.resize(n);
+      for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+        binnings[iColumn].findBins(values[iColumn], n, shard.bins.data());
+        shard.counts[iColumn].add(shard.bins.data(), n);
+      }
+    });
+
+    uint64_t entriesAfter = 0;
+    for (auto const& shard : shards) {
+      entriesAfter += shard.counts[0].entries();
+    }
+    return entriesAfter - entriesBefore;
+  }
+
+  /// Fills the rows of MyTable passing the windows, returns their number
+  uint64_t readStandard(aod::MyTable const& cand2Prongs)
+  {
+    if (nReaderThreads > 1) {
+      return readParallel(cand2Prongs);
+    }
+
+    // loop over 2-prong candidates
+    uint64_t nFilled = 0;
+    for (auto& cand : cand2Prongs) {
+      if (!inWindows(cand.pt(), cand.invMassD0(), cand.invMassD0bar())) {
+        continue;
+      }
+      nFilled++;
+      massD0Buffer.fill(cand.invMassD0());
+      massD0barBuffer.fill(cand.invMassD0bar());
+      ptBuffer.fill(cand.pt());
+      cospBuffer.fill(cand.cosinePointing());
+    }
+    flushBuffers();
+    return nFilled;
+  }
+
+  // the 16-bit columns are decoded with the codecs stored in the same dataframe,
+  // one group of 4 rows per dataframe of the producer; when several of them
+  // were merged into one (o2-aod-merger, ntfmerge > 1) the groups must agree
+  uint64_t readCompact(aod::MyTableCompact const& cand2Prongs, aod::MyTableCodecs const& codecRows)
+  {
+    if (cand2Prongs.size() == 0) {
+      return 0;
+    }
+    std::array<ColumnCodec, 4> codecs;
+    const int64_t nCodecs = codecs.size();
+    if (codecRows.size() == 0 || codecRows.size() % nCodecs != 0) {
+      LOGF(fatal, "Expected a multiple of %d MyTableCodecs rows per dataframe, found %d", nCodecs, codecRows.size());
+    }
+    int64_t iRow = 0;
+    for (auto& row : codecRows) {
+      const ColumnCodec codec{static_cast<ColumnEncoding>(row.encoding()), row.min(), row.max(), row.resolution()};
+      auto& first = codecs[iRow % nCodecs];
+      if (iRow < nCodecs) {
+        first = codec;
+      } else if (codec.encoding != first.encoding || codec.min != first.min || codec.max != first.max || codec.resolution != first.resolution) {
+        LOGF(fatal, "MyTableCodecs row %d differs from row %d: merged dataframes written with different codecs", iRow, iRow % nCodecs);
+      }
+      iRow++;
+    }
+
+    uint64_t nFilled = 0;
+    for (auto& cand : cand2Prongs) {
+      float invMassD0 = codecs[0].decode(cand.invMassD0Code());
+      float invMassD0bar = codecs[1].decode(cand.invMassD0barCode());
+      float pt = codecs[2].decode(cand.ptCode());
+      if (!inWindows(pt, invMassD0, invMassD0bar)) {
+        continue;
+      }
+      nFilled++;
+      massD0Buffer.fill(invMassD0);
+      massD0barBuffer.fill(invMassD0bar);
+      ptBuffer.fill(pt);
+      cospBuffer.fill(codecs[3].decode(cand.cosinePointingCode()));
+    }
+    flushBuffers();
+    return nFilled;
+  }
+
+  // per-collision view of MyTable through the slice index, no grouping needed
+  // (float output only, the slices of a compact skim index MyTableCompact).
+  // The slices cover MyTable contiguously and their offsets restart at 0 in
+  // every dataframe of the producer; when several of them were merged into
+  // one (o2-aod-merger, ntfmerge > 1) the offsets are rebased on the rows of
+  // the merged parts before
+  uint64_t readPerCollision(aod::MyTable const& cand2Prongs, aod::MyCollisionSlices const& slices)
+  {
+    uint64_t nFilled = 0;
+    int64_t base = 0; // first row of the current merged part
+    int64_t end = 0;  // row after the previous slice
+    for (auto& slice : slices) {
+      if (base + slice.offset() != end) {
+        if (slice.offset() != 0) {
+          LOGF(fatal, "Collision %d: slice at offset %d, expected %d or 0 (new merged dataframe)", slice.collisionId(), slice.offset(), end - base);
+        }
+        base = end;
+      }
+      const int64_t first = base + slice.offset();
+      if (slice.nCandidates() <= 0 || first + slice.nCandidates() > cand2Prongs.size()) {
+        LOGF(fatal, "Collision %d: rows [%d, %d) outside MyTable of %d rows", slice.collisionId(), first, first + slice.nCandidates(), cand2Prongs.size());
+      }
+      end = first + slice.nCandidates();
+      auto candidates = cand2Prongs.rawSlice(first, end - 1);
+      int nSelected = 0;
+      float ptLeading = 0.f;
+      for (auto& cand : candidates) {
+        if (!inWindows(cand.pt(), cand.invMassD0(), cand.invMassD0bar())) {
+          continue;
+        }
+        nSelected++;
+        ptLeading = std::max(ptLeading, cand.pt());
+        massD0Buffer.fill(cand.invMassD0());
+        massD0barBuffer.fill(cand.invMassD0bar());
+        ptBuffer.fill(cand.pt());
+        cospBuffer.fill(cand.cosinePointing());
+      }
+      if (nSelected > 0) {
+        registry.fill(HIST("hNCandidates"), nSelected);
+        registry.fill(HIST("hPtLeading"), ptLeading);
+      }
+      nFilled += nSelected;
+    }
+    flushBuffers();
+    return nFilled;
+  }
+
+  void processStandard(aod::MyTable const& cand2Prongs)
+  {
+    auto profile = profiler.measure(0, cand2Prongs.size());
+    profile.addRowsOut(readStandard(cand2Prongs));
+  }
+  PROCESS_SWITCH(ReadDerivedTable, processStandard, "Read the float MyTable", true);
+
+  void processCompact(aod::MyTableCompact const& cand2Prongs, aod::MyTableCodecs const& codecRows)
+  {
+    auto profile = profiler.measure(1, cand2Prongs.size());
+    profile.addRowsOut(readCompact(cand2Prongs, codecRows));
+  }
+  PROCESS_SWITCH(ReadDerivedTable, processCompact, "Read the 16-bit MyTableCompact", false);
+
+  void processPerCollision(aod::MyTable const& cand2Prongs, aod::MyCollisionSlices const& slices)
+  {
+    auto profile = profiler.measure(2, cand2Prongs.size());
+    profile.addRowsOut(readPerCollision(cand2Prongs, slices));
+  }
+  PROCESS_SWITCH(ReadDerivedTable, processPerCollision, "Read MyTable collision by collision", false);
+
+  // the same reads, skipping the dataframes excluded by the zone maps
+  void processStandardPruned(aod::MyTable const& cand2Prongs, aod::MyZoneMaps const& zoneMaps)
+  {
+    auto profile = profiler.measure(3, cand2Prongs.size());
+    if (!pruneDataframe(zoneMaps, cand2Prongs.size())) {
+      profile.addRowsOut(readStandard(cand2Prongs));
+    }
+  }
+  PROCESS_SWITCH(ReadDerivedTable, processStandardPruned, "Read the float MyTable with zone map pruning", false);
+
+  void processCompactPruned(aod::MyTableCompact const& cand2Prongs, aod::MyTableCodecs const& codecRows, aod::MyZoneMaps const& zoneMaps)
+  {
+    auto profile = profiler.measure(4, cand2Prongs.size());
+    if (!pruneDataframe(zoneMaps, cand2Prongs.size())) {
+      profile.addRowsOut(readCompact(cand2Prongs, codecRows));
+    }
+  }
+  PROCESS_SWITCH(ReadDerivedTable, processCompactPruned, "Read the 16-bit MyTableCompact with zone map pruning", false);
+
+  void processPerCollisionPruned(aod::MyTable const& cand2Prongs, aod::MyCollisionSlices const& slices, aod::MyZoneMaps const& zoneMaps)
+  {
+    auto profile = profiler.measure(5, cand2Prongs.size());
+    if (!pruneDataframe(zoneMaps, cand2Prongs.size())) {
+      profile.addRowsOut(readPerCollision(cand2Prongs, slices));
+    }
+  }
+  PROCESS_SWITCH(ReadDerivedTable, processPerCollisionPruned, "Read MyTable collision by collision with zone map pruning", false);
+};
+
+#endif // READDERIVEDTABLE_H_
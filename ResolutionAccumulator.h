@@ -0,0 +1,215 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file ResolutionAccumulator.h
+/// \brief Streaming statistics of a residual (e.g. pT - pT MC) in bins of a
+///        variable: count, mean and variance (Welford) and the 2.5, 16, 84
+///        and 97.5% quantiles, estimated with the extended P-square algorithm
+///        (eleven markers shared by the four quantiles, no stored values). The
+///        memory is fixed per bin whatever the residual range, and the
+///        widths sigma68 = (q84 - q16) / 2 and sigma95 = (q97.5 - q2.5) / 4
+///        need no fit. Results are copied into TH1s at output time.
+/// \author
+/// \since
+
+#ifndef RESOLUTIONACCUMULATOR_H_
+#define RESOLUTIONACCUMULATOR_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "TH1.h"
+
+namespace o2::analysis::hadrex
+{
+
+/// Extended P-square estimate (Raatikainen) of N quantiles p_1 < ... < p_N,
+/// with 2N + 3 markers at the probabilities 0, p_1 / 2, p_1, (p_1 + p_2) / 2,
+/// ..., p_N, (p_N + 1) / 2, 1; the marker heights are adjusted by piecewise
+/// parabolic interpolation as in the single-quantile algorithm
+template <std::size_t N>
+class P2Quantiles
+{
+ public:
+  static constexpr std::size_t nMarkers = 2 * N + 3;
+
+  explicit P2Quantiles(std::array<double, N> const& levels)
+  {
+    mIncrements[0] = 0.;
+    for (std::size_t i = 0; i < N; ++i) {
+      mIncrements[2 * i + 2] = levels[i];
+      mIncrements[2 * i + 1] = (mIncrements[2 * i] + levels[i]) / 2.;
+    }
+    mIncrements[nMarkers - 1] = 1.;
+    mIncrements[nMarkers - 2] = (levels[N - 1] + 1.) / 2.;
+  }
+
+  void add(double x)
+  {
+    // the first values are kept sorted and become the initial markers
+    if (mCount < static_cast<int64_t>(nMarkers)) {
+      std::size_t i = mCount++;
+      for (; i > 0 && mHeights[i - 1] > x; --i) {
+        mHeights[i] = mHeights[i - 1];
+      }
+      mHeights[i] = x;
+      if (mCount == static_cast<int64_t>(nMarkers)) {
+        for (std::size_t m = 0; m < nMarkers; ++m) {
+          mPositions[m] = m;
+          mDesired[m] = (nMarkers - 1) * mIncrements[m];
+        }
+      }
+      return;
+    }
+    ++mCount;
+
+    // cell of x, extending the extreme markers if needed
+    std::size_t k;
+    if (x < mHeights[0]) {
+      mHeights[0] = x;
+      k = 0;
+    } else if (x >= mHeights[nMarkers - 1]) {
+      mHeights[nMarkers - 1] = x;
+      k = nMarkers - 2;
+    } else {
+      k = static_cast<std::size_t>(std::upper_bound(mHeights.begin() + 1, mHeights.end(), x) - mHeights.begin()) - 1;
+    }
+    for (std::size_t m = k + 1; m < nMarkers; ++m) {
+      ++mPositions[m];
+    }
+    for (std::size_t m = 0; m < nMarkers; ++m) {
+      mDesired[m] += mIncrements[m];
+    }
+
+    // move the inner markers towards their desired positions
+    for (std::size_t m = 1; m < nMarkers - 1; ++m) {
+      const double d = mDesired[m] - mPositions[m];
+      if ((d >= 1. && mPositions[m + 1] - mPositions[m] > 1) || (d <= -1. && mPositions[m - 1] - mPositions[m] < -1)) {
+        const int step = d > 0. ? 1 : -1;
+        double height = parabolic(m, step);
+        if (!(mHeights[m - 1] < height && height < mHeights[m + 1])) {
+          height = mHeights[m] + step * (mHeights[m + step] - mHeights[m]) / (mPositions[m + step] - mPositions[m]);
+        }
+        mHeights[m] = height;
+        mPositions[m] += step;
+      }
+    }
+  }
+
+  /// Estimate of the quantile p_(i+1); with fewer values than markers, the
+  /// nearest of the sorted values
+  double value(std::size_t i) const
+  {
+    if (mCount == 0) {
+      return NAN;
+    }
+    if (mCount < static_cast<int64_t>(nMarkers)) {
+      return mHeights[std::min<int64_t>(static_cast<int64_t>(mIncrements[2 * i + 2] * mCount), mCount - 1)];
+    }
+    return mHeights[2 * i + 2];
+  }
+
+ private:
+  double parabolic(std::size_t m, int step) const
+  {
+    const double nMinus = mPositions[m - 1], n = mPositions[m], nPlus = mPositions[m + 1];
+    return mHeights[m] + step / (nPlus - nMinus) *
+                           ((n - nMinus + step) * (mHeights[m + 1] - mHeights[m]) / (nPlus - n) +
+                            (nPlus - n - step) * (mHeights[m] - mHeights[m - 1]) / (n - nMinus));
+  }
+
+  int64_t mCount = 0;
+  std::array<double, nMarkers> mHeights = {};
+  std::array<int64_t, nMarkers> mPositions = {};
+  std::array<double, nMarkers> mDesired = {};
+  std::array<double, nMarkers> mIncrements = {};
+};
+
+class ResolutionAccumulator
+{
+ public:
+  /// Levels of the estimated quantiles
+  static constexpr std::array<double, 4> quantileLevels = {0.025, 0.16, 0.84, 0.975};
+
+  struct Bin {
+    int64_t count = 0;
+    double mean = 0.;
+    double m2 = 0.;
+    P2Quantiles<4> quantiles{quantileLevels};
+
+    double variance() const { return count > 1 ? m2 / (count - 1) : 0.; }
+    double quantile(int i) const { return quantiles.value(i); }
+    double sigma68() const { return (quantile(2) - quantile(1)) / 2.; }
+    double sigma95() const { return (quantile(3) - quantile(0)) / 4.; }
+  };
+
+  /// Fixed-width bins of the variable x, values outside are not accumulated
+  void setBinning(int nBins, double xMin, double xMax)
+  {
+    mXMin = xMin;
+    mInvWidth = nBins / (xMax - xMin);
+    mBins.assign(nBins, Bin());
+  }
+
+  void fill(double x, double residual)
+  {
+    if (!(x >= mXMin)) {
+      return;
+    }
+    const auto bin = static_cast<std::size_t>((x - mXMin) * mInvWidth);
+    if (bin >= mBins.size()) {
+      return;
+    }
+    Bin& b = mBins[bin];
+    ++b.count;
+    const double delta = residual - b.mean;
+    b.mean += delta / b.count;
+    b.m2 += delta * (residual - b.mean);
+    b.quantiles.add(residual);
+  }
+
+  std::vector<Bin> const& bins() const { return mBins; }
+
+  /// Copies one quantity per bin into TH1s with the same binning (bin i at
+  /// i + 1); the mean gets its statistical error, empty bins stay empty
+  void copyTo(TH1* count, TH1* mean, TH1* stdDev, TH1* sigma68, TH1* sigma95, std::array<TH1*, 4> const& quantileHistograms) const
+  {
+    for (std::size_t i = 0; i < mBins.size(); ++i) {
+      Bin const& b = mBins[i];
+      const int bin = i + 1;
+      count->SetBinContent(bin, b.count);
+      if (b.count == 0) {
+        continue;
+      }
+      const double sigma = std::sqrt(b.variance());
+      mean->SetBinContent(bin, b.mean);
+      mean->SetBinError(bin, sigma / std::sqrt(static_cast<double>(b.count)));
+      stdDev->SetBinContent(bin, sigma);
+      sigma68->SetBinContent(bin, b.sigma68());
+      sigma95->SetBinContent(bin, b.sigma95());
+      for (int q = 0; q < 4; ++q) {
+        quantileHistograms[q]->SetBinContent(bin, b.quantile(q));
+      }
+    }
+  }
+
+ private:
+  double mXMin = 0.;
+  double mInvWidth = 1.;
+  std::vector<Bin> mBins;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // RESOLUTIONACCUMULATOR_H_
@@ -0,0 +1,83 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file SkipCounter.h
+/// \brief Counts, once per dataframe, the collisions rejected by a collision
+///        Filter and the rows of a table grouped by collision (tracks, V0s)
+///        that belong to them, i.e. the rows the grouped process functions
+///        never see. The collision index column is read in place; rows
+///        without a collision are not counted.
+/// \author
+/// \since
+
+#ifndef SKIPCOUNTER_H_
+#define SKIPCOUNTER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Framework/HistogramRegistry.h"
+
+#include "ColumnReader.h"
+
+namespace o2::analysis::hadrex
+{
+
+class SkipCounter
+{
+ public:
+  /// Books "selection/hSkipped" in the task registry, to be called in init()
+  void init(o2::framework::HistogramRegistry& registry, std::string const& rowsName)
+  {
+    using namespace o2::framework;
+    mHistogram = registry.add<TH1>("selection/hSkipped", "collisions and grouped rows skipped by the collision Filter", {HistType::kTH1D, {{4, 0.5, 4.5}}});
+    mHistogram->GetXaxis()->SetBinLabel(1, "collisions");
+    mHistogram->GetXaxis()->SetBinLabel(2, "collisions skipped");
+    mHistogram->GetXaxis()->SetBinLabel(3, rowsName.c_str());
+    mHistogram->GetXaxis()->SetBinLabel(4, (rowsName + " skipped").c_str());
+  }
+
+  /// selected: the Filtered collision table; rows: the unfiltered grouped table
+  template <typename TSelected, typename TRows>
+  void count(TSelected const& selected, TRows const& rows)
+  {
+    const int64_t nCollisions = selected.tableSize();
+    mAccepted.assign(nCollisions, 0);
+    for (auto& collision : selected) {
+      mAccepted[collision.globalIndex()] = 1;
+    }
+    auto table = rows.asArrowTable();
+    ColumnReader<int32_t> collisionId(*table, "fIndexCollisions");
+    uint64_t nRows = 0, nSkipped = 0;
+    for (int64_t row = 0; row < collisionId.size(); ++row) {
+      const int32_t index = collisionId[row];
+      if (index < 0 || index >= nCollisions) {
+        continue;
+      }
+      nRows++;
+      nSkipped += !mAccepted[index];
+    }
+    mHistogram->Fill(1., nCollisions);
+    mHistogram->Fill(2., nCollisions - selected.size());
+    mHistogram->Fill(3., nRows);
+    mHistogram->Fill(4., nSkipped);
+  }
+
+ private:
+  std::shared_ptr<TH1> mHistogram;
+  std::vector<uint8_t> mAccepted;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // SKIPCOUNTER_H_
@@ -0,0 +1,317 @@
+#!/usr/bin/env python3
+# Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+# See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+# All rights not expressly granted are reserved.
+#
+# This software is distributed under the terms of the GNU General Public
+# License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+#
+# In applying this license CERN does not waive the privileges and immunities
+# granted to it by virtue of its status as an Intergovernmental Organization
+# or submit itself to any jurisdiction.
+
+"""Runs a workflow script over a list of AO2D files with N pipelines in parallel.
+
+Every input file is one shard. N workers take the next shard from a shared
+queue each time their previous pipeline ends, so that a slow file does not
+hold back a statically assigned share of the list. A shard runs the script
+(e.g. run-h1-final.sh) in its own directory <work-dir>/shard-<i>/<attempt>
+with
+- a copy of the dpl-config where aod-file is the shard input and relative
+  paths that exist next to the configuration are made absolute, passed as
+  HADREX_DPL_CONFIG,
+- its own DPL session (--session), passed in HADREX_EXTRA_OPT, so that the
+  pipelines do not share channels or shared memory,
+- links to the files named in the script that are next to it (e.g.
+  OutputDirector.json).
+
+A shard whose pipeline fails, or ends without AnalysisResults.root, is put
+back in the queue up to --retries times; the other shards are not rerun.
+
+At the end the AnalysisResults.root of the shards are merged with hadd, and
+every other ROOT file the shards wrote (derived AO2D, e.g. AO2D_derived.root)
+with o2-aod-merger, into the output directory. The merged derived AO2D keeps
+the dataframes of the shards as they are, one output dataframe per input one. The report gives the wall
+time, input MB/s and, with --event-histogram, events/s of every shard and of
+the whole batch.
+
+Example:
+  ./Tools/batch-run.py -j 4 --files period.txt --config dpl-config-h1-final.json \\
+      --event-histogram momentumresolution/hVertexZ run-h1-final.sh
+"""
+
+import argparse
+import importlib.util
+import json
+import os
+import queue
+import re
+import subprocess
+import sys
+import threading
+import time
+
+REPO_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+READER = "internal-dpl-aod-reader"
+RESULTS = "AnalysisResults.root"
+
+
+def load_results_file_class():
+    spec = importlib.util.spec_from_file_location("benchmark_workflows", os.path.join(REPO_DIR, "Benchmark", "benchmark-workflows.py"))
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module.ResultsFile
+
+
+def read_file_list(path):
+    with open(path) as f:
+        files = [line.strip() for line in f if line.strip() and not line.startswith("#")]
+    return [os.path.abspath(os.path.join(os.path.dirname(os.path.abspath(path)), name)) for name in files]
+
+
+def absolute_paths(value, base_dir):
+    """Configuration with the relative paths that exist under base_dir made absolute"""
+    if isinstance(value, dict):
+        return {key: absolute_paths(item, base_dir) for key, item in value.items()}
+    if isinstance(value, str) and value and not os.path.isabs(value) and "://" not in value:
+        candidate = os.path.join(base_dir, value)
+        if os.path.exists(candidate):
+            return os.path.abspath(candidate)
+    return value
+
+
+def linked_files(script):
+    """Files named in the script that exist in its directory"""
+    script_dir = os.path.dirname(script)
+    with open(script) as f:
+        words = set(re.findall(r"[A-Za-z0-9_.\-/]+\.(?:json|root|txt)", f.read()))
+    return sorted(word for word in words if not os.path.isabs(word) and os.path.isfile(os.path.join(script_dir, word)))
+
+
+class Shard:
+    def __init__(self, index, input_file):
+        self.index = index
+        self.input = input_file
+        self.attempts = []  # {"directory", "returnCode", "wallTime"}
+        self.status = "pending"
+        self.events = None
+
+    @property
+    def directory(self):
+        return self.attempts[-1]["directory"] if self.attempts else None
+
+    @property
+    def wall_time(self):
+        return self.attempts[-1]["wallTime"] if self.attempts else None
+
+    def size(self):
+        return os.path.getsize(self.input) if os.path.exists(self.input) else 0
+
+
+class BatchRunner:
+    def __init__(self, args):
+        self.script = os.path.abspath(args.script)
+        self.config_file = os.path.abspath(args.config)
+        with open(self.config_file) as f:
+            self.config = absolute_paths(json.load(f), os.path.dirname(self.config_file))
+        self.links = linked_files(self.script)
+        self.work_dir = os.path.abspath(args.work_dir)
+        self.retries = args.retries
+        self.extra_opt = args.extra_opt
+        self.queue = queue.Queue()
+        self.lock = threading.Lock()
+        self.session_prefix = f"batch{os.getpid()}"
+
+    def shard_config(self, shard, directory):
+        config = json.loads(json.dumps(self.config))
+        config.setdefault(READER, {})
+        if not isinstance(config[READER], dict):
+            config[READER] = {}
+        config[READER]["aod-file"] = shard.input
+        path = os.path.join(directory, "dpl-config.json")
+        with open(path, "w") as f:
+            json.dump(config, f, indent=4)
+        return path
+
+    def run_shard(self, shard, worker):
+        attempt = len(shard.attempts)
+        directory = os.path.join(self.work_dir, f"shard-{shard.index}", str(attempt))
+        os.makedirs(directory, exist_ok=True)
+        for name in self.links:
+            link = os.path.join(directory, name)
+            if not os.path.lexists(link):
+                os.makedirs(os.path.dirname(link), exist_ok=True)
+                os.symlink(os.path.join(os.path.dirname(self.script), name), link)
+
+        env = dict(os.environ)
+        env["HADREX_DPL_CONFIG"] = self.shard_config(shard, directory)
+        env["HADREX_EXTRA_OPT"] = f"--session {self.session_prefix}s{shard.index}a{attempt} {self.extra_opt}".strip()
+        start = time.monotonic()
+        with open(os.path.join(directory, "log.txt"), "w") as log:
+            process = subprocess.run(["bash", self.script], cwd=directory, env=env, stdout=log, stderr=subprocess.STDOUT)
+        wall = time.monotonic() - start
+        ok = process.returncode == 0 and os.path.exists(os.path.join(directory, RESULTS))
+
+        with self.lock:
+            shard.attempts.append({"directory": directory, "returnCode": process.returncode, "wallTime": wall, "worker": worker})
+            if ok:
+                shard.status = "done"
+            elif attempt < self.retries:
+                shard.status = "retrying"
+                self.queue.put(shard)
+            else:
+                shard.status = "failed"
+            print(f"[worker {worker}] shard {shard.index} attempt {attempt}: {shard.status} in {wall:.1f} s ({os.path.basename(shard.input)})", flush=True)
+
+    def worker(self, worker):
+        while True:
+            shard = self.queue.get()
+            if shard is None:
+                self.queue.task_done()
+                return
+            try:
+                self.run_shard(shard, worker)
+            finally:
+                self.queue.task_done()
+
+    def run(self, shards, n_workers):
+        for shard in shards:
+            self.queue.put(shard)
+        threads = [threading.Thread(target=self.worker, args=(i,)) for i in range(n_workers)]
+        for thread in threads:
+            thread.start()
+        # retried shards are queued before the failed attempt is marked done
+        self.queue.join()
+        for _ in threads:
+            self.queue.put(None)
+        for thread in threads:
+            thread.join()
+
+
+def merge(shards, output_dir):
+    """hadd of AnalysisResults.root, o2-aod-merger of the other ROOT outputs; returns the failed merges"""
+    os.makedirs(output_dir, exist_ok=True)
+    done = [shard for shard in shards if shard.status == "done"]
+    outputs = {}
+    for shard in done:
+        for name in sorted(os.listdir(shard.directory)):
+            path = os.path.join(shard.directory, name)
+            if name.endswith(".root") and not os.path.islink(path):
+                outputs.setdefault(name, []).append(path)
+
+    failures = []
+    for name, inputs in sorted(outputs.items()):
+        target = os.path.join(output_dir, name)
+        if name == RESULTS:
+            command = ["hadd", "-f", target] + inputs
+        else:
+            list_file = os.path.join(output_dir, name + ".inputs.txt")
+            with open(list_file, "w") as f:
+                f.write("\n".join(inputs) + "\n")
+            # o2-aod-merger concatenates input dataframes until an output one reaches
+            # --max-size (100 MB by default); 1 byte keeps one output dataframe per
+            # input dataframe, so per-dataframe tables (zone maps, codecs, slice
+            # offsets) stay aligned with the rows they describe
+            command = ["o2-aod-merger", "--input", list_file, "--output", target, "--max-size", "1"]
+        with open(os.path.join(output_dir, name + ".merge.log"), "w") as log:
+            result = subprocess.run(command, stdout=log, stderr=subprocess.STDOUT)
+        status = "merged" if result.returncode == 0 else "FAILED"
+        print(f"{status} {len(inputs)} x {name} -> {target}")
+        if result.returncode != 0:
+            failures.append(name)
+    return failures
+
+
+def report(shards, total_wall, event_histogram, report_file):
+    ResultsFile = load_results_file_class() if event_histogram else None
+    rows = []
+    for shard in shards:
+        row = {
+            "shard": shard.index,
+            "input": shard.input,
+            "status": shard.status,
+            "attempts": len(shard.attempts),
+            "wallTime": shard.wall_time,
+            "inputMB": shard.size() / 1e6,
+            "events": None,
+        }
+        if ResultsFile and shard.status == "done":
+            try:
+                row["events"] = ResultsFile(os.path.join(shard.directory, RESULTS)).entries(event_histogram)
+            except Exception as error:  # a shard without the histogram does not stop the report
+                print(f"shard {shard.index}: no {event_histogram} ({error})")
+        rows.append(row)
+
+    print(f"{'shard':>5} {'status':8} {'tries':>5} {'wall (s)':>9} {'MB':>9} {'MB/s':>8} {'events/s':>10}  input")
+    for row in rows:
+        wall = row["wallTime"] or 0.
+        rate = row["inputMB"] / wall if wall > 0 else 0.
+        events = f"{row['events'] / wall:10.1f}" if row["events"] is not None and wall > 0 else " " * 10
+        print(f"{row['shard']:5d} {row['status']:8} {row['attempts']:5d} {wall:9.1f} {row['inputMB']:9.1f} {rate:8.2f} {events}  {os.path.basename(row['input'])}")
+
+    done = [row for row in rows if row["status"] == "done"]
+    total_mb = sum(row["inputMB"] for row in done)
+    shard_wall = sum(attempt["wallTime"] for shard in shards for attempt in shard.attempts)
+    summary = {
+        "shards": len(rows),
+        "done": len(done),
+        "failed": sum(1 for row in rows if row["status"] == "failed"),
+        "retries": sum(max(row["attempts"] - 1, 0) for row in rows),
+        "wallTime": total_wall,
+        "inputMBPerSecond": total_mb / total_wall if total_wall > 0 else None,
+        "eventsPerSecond": None,
+        "parallelEfficiency": shard_wall / total_wall if total_wall > 0 else None,
+    }
+    events = [row["events"] for row in done if row["events"] is not None]
+    if events and total_wall > 0:
+        summary["eventsPerSecond"] = sum(events) / total_wall
+    print(
+        f"total: {summary['done']}/{summary['shards']} shards in {total_wall:.1f} s, {summary['retries']} retries, "
+        f"{total_mb:.1f} MB at {summary['inputMBPerSecond'] or 0.:.2f} MB/s"
+        + (f", {summary['eventsPerSecond']:.1f} events/s" if summary["eventsPerSecond"] else "")
+        + f", {summary['parallelEfficiency'] or 0.:.2f} pipelines busy on average"
+    )
+    if report_file:
+        with open(report_file, "w") as f:
+            json.dump({"summary": summary, "shards": rows}, f, indent=2)
+    return summary
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("script", help="workflow script, e.g. run-h1-final.sh")
+    parser.add_argument("--files", required=True, help="text file with one AO2D file per line")
+    parser.add_argument("--config", required=True, help="dpl-config JSON of the workflow")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 1, help="pipelines running in parallel")
+    parser.add_argument("--retries", type=int, default=1, help="extra attempts for a failed shard")
+    parser.add_argument("-w", "--work-dir", default="batch-shards", help="directory of the shards")
+    parser.add_argument("-o", "--output-dir", default="batch-merged", help="directory of the merged outputs")
+    parser.add_argument("--event-histogram", help="histogram whose entries count the events, e.g. momentumresolution/hVertexZ")
+    parser.add_argument("--extra-opt", default="", help="extra DPL options for every pipeline")
+    parser.add_argument("--report", help="also write the report to this JSON file")
+    parser.add_argument("--no-merge", action="store_true", help="keep the shard outputs only")
+    args = parser.parse_args()
+
+    inputs = read_file_list(args.files)
+    if not inputs:
+        parser.error(f"no input file in {args.files}")
+    shards = [Shard(i, input_file) for i, input_file in enumerate(inputs)]
+    runner = BatchRunner(args)
+    print(f"{len(shards)} shards on {min(args.jobs, len(shards))} pipelines, linked files: {', '.join(runner.links) or 'none'}", flush=True)
+
+    start = time.monotonic()
+    runner.run(shards, max(1, min(args.jobs, len(shards))))
+    total_wall = time.monotonic() - start
+
+    merge_failures = [] if args.no_merge else merge(shards, os.path.abspath(args.output_dir))
+    summary = report(shards, total_wall, args.event_histogram, args.report)
+    if summary["failed"] or merge_failures:
+        failed = [str(shard.index) for shard in shards if shard.status == "failed"]
+        if failed:
+            print(f"failed shards: {', '.join(failed)}, see {args.work_dir}/shard-<i>/<attempt>/log.txt")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+# Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+# See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+# All rights not expressly granted are reserved.
+#
+# This software is distributed under the terms of the GNU General Public
+# License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+#
+# In applying this license CERN does not waive the privileges and immunities
+# granted to it by virtue of its status as an Intergovernmental Organization
+# or submit itself to any jurisdiction.
+
+"""Local CCDB snapshot for the dpl-config files.
+
+Collects the CCDB paths that the devices of the given dpl-config files read
+(options like rct-path, lutPath, ccdbPath), downloads each object valid at
+--timestamp with o2-ccdb-downloadccdbfile into <dir>/<path>/snapshot.root,
+and writes a copy of every configuration with ccdb-url set to file://<dir>.
+The CCDB API reads a file:// URL as a snapshot directory, so the jobs then
+start without network access.
+
+The run information (rct-path, RCT/Info/RunInformation, RCT/RunInformation)
+is stored per run under <path>/<run number>: these paths are downloaded for
+the run given with --run.
+
+A snapshot holds one object per path, valid for the timestamp it was taken
+at: it is meant for inputs from a single run.
+
+The report gives the state of every object in the snapshot directory:
+present (there before this call), added (downloaded by this call) or failed
+(still absent after the download). With --check nothing is downloaded and
+the objects not in the snapshot are listed as absent.
+
+Example:
+  ./Tools/ccdb-snapshot.py -d ccdb-snapshot -t 1635324640000 --run 505673 dpl-config-h1-final.json dpl-config-h3-final.json
+  HADREX_DPL_CONFIG=dpl-config-h1-final.local.json ./run-h1-final.sh
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+# CCDB object paths are slash-separated words, e.g. GLO/Param/MatLUT
+PATH_VALUE = re.compile(r"^[A-Za-z0-9_\-]+(/[A-Za-z0-9_\-]+)+$")
+# options holding a CCDB path; options ending in "Locally" are local files
+PATH_OPTION = re.compile(r"(path|Path|PathCCDB)$")
+URL_OPTION = "ccdb-url"
+# paths whose objects are keyed by run number, <path>/<run>
+RUN_KEYED_OPTIONS = {"rct-path"}
+RUN_KEYED_PATHS = {"RCT/Info/RunInformation", "RCT/RunInformation"}
+
+
+def ccdb_requests(config):
+    """[(device, option, url, path)] for every CCDB path option of a dpl-config"""
+    requests = []
+    for device, options in config.items():
+        if not isinstance(options, dict) or URL_OPTION not in options:
+            continue
+        url = options[URL_OPTION]
+        for option, value in options.items():
+            if isinstance(value, str) and PATH_OPTION.search(option) and PATH_VALUE.match(value):
+                requests.append((device, option, url, value))
+    return requests
+
+
+def is_run_keyed(option, path):
+    return option in RUN_KEYED_OPTIONS or path in RUN_KEYED_PATHS
+
+
+def snapshot_file(directory, path):
+    return os.path.join(directory, path, "snapshot.root")
+
+
+def download(url, path, timestamp, directory):
+    command = ["o2-ccdb-downloadccdbfile", "--host", url, "-p", path, "-t", str(timestamp), "-d", directory]
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    return result.returncode == 0, result.stdout
+
+
+def local_config_name(config_file):
+    base, extension = os.path.splitext(config_file)
+    return base + ".local" + extension
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("configs", nargs="+", help="dpl-config JSON files")
+    parser.add_argument("-d", "--directory", default="ccdb-snapshot", help="snapshot directory")
+    parser.add_argument("-t", "--timestamp", type=int, help="validity timestamp of the objects (ms since epoch)")
+    parser.add_argument("--run", type=int, help="run number of the run-keyed paths (run information)")
+    parser.add_argument("--check", action="store_true", help="only report which objects are in the snapshot")
+    parser.add_argument("--report", help="also write the report to this JSON file")
+    args = parser.parse_args()
+    if not args.check and args.timestamp is None:
+        parser.error("--timestamp is needed to download objects")
+
+    directory = os.path.abspath(args.directory)
+    configs = {}
+    for config_file in args.configs:
+        with open(config_file) as f:
+            configs[config_file] = json.load(f)
+    run_keyed = sorted({path for config in configs.values() for _, option, _, path in ccdb_requests(config) if is_run_keyed(option, path)})
+    if run_keyed and args.run is None:
+        parser.error(f"--run is needed for the run-keyed paths {', '.join(run_keyed)}")
+
+    report = {}
+    for config_file, config in configs.items():
+        for device, option, url, path in ccdb_requests(config):
+            if is_run_keyed(option, path):
+                path = f"{path}/{args.run}"
+            entry = report.setdefault(path, {"url": url, "users": [], "status": None, "size": None})
+            entry["users"].append(f"{os.path.basename(config_file)}:{device}.{option}")
+            if entry["status"] is not None:
+                continue
+            target = snapshot_file(directory, path)
+            if os.path.exists(target):
+                entry["status"] = "present"
+            elif args.check:
+                entry["status"] = "absent"
+            else:
+                ok, output = download(url, path, args.timestamp, directory)
+                entry["status"] = "added" if ok and os.path.exists(target) else "failed"
+                if entry["status"] == "failed":
+                    entry["error"] = output.strip().splitlines()[-1:] if output else []
+            if os.path.exists(target):
+                entry["size"] = os.path.getsize(target)
+
+        if not args.check:
+            local = json.loads(json.dumps(config))
+            for options in local.values():
+                if isinstance(options, dict) and URL_OPTION in options:
+                    options[URL_OPTION] = "file://" + directory
+            with open(local_config_name(config_file), "w") as f:
+                json.dump(local, f, indent=4)
+
+    width = max((len(path) for path in report), default=0)
+    for path, entry in sorted(report.items()):
+        size = f"{entry['size'] / 1e6:9.2f} MB" if entry["size"] is not None else " " * 12
+        print(f"{entry['status']:7} {path:{width}} {size}  {', '.join(entry['users'])}")
+    counts = {status: sum(1 for e in report.values() if e["status"] == status) for status in ("present", "added", "failed", "absent")}
+    print(f"{len(report)} objects: " + ", ".join(f"{count} {status}" for status, count in counts.items() if count or status != "absent"))
+    if not args.check:
+        for config_file in args.configs:
+            print(f"local configuration: {local_config_name(config_file)}")
+
+    if args.report:
+        with open(args.report, "w") as f:
+            json.dump(report, f, indent=2)
+    if counts["failed"] or counts["absent"]:
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+# Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+# See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+# All rights not expressly granted are reserved.
+#
+# This software is distributed under the terms of the GNU General Public
+# License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+#
+# In applying this license CERN does not waive the privileges and immunities
+# granted to it by virtue of its status as an Intergovernmental Organization
+# or submit itself to any jurisdiction.
+
+"""Runs the h1-h4 and jet chains on a synthetic AO2D file.
+
+The file is written by o2-analysistutorial-synthetic-ao2d (Run 3 MC, one
+collision per BC with TVX-triggered FIT signals) unless it exists already.
+Each chain runs through Tools/batch-run.py in <work-dir>/<chain>, with a copy
+of its dpl-config where
+- the timestamp task reads the run information from RCT/Info/RunInformation,
+- the h3 configuration, written for Run 2 data, runs the Run 3 process
+  functions with the pp event selection for MC,
+so that the synthetic file goes through the same devices as the real input.
+The run number of the file (--run-number of the generator, 505673 by
+default) must be known to the CCDB the configurations point to (see
+Tools/ccdb-snapshot.py for an offline snapshot).
+
+Chains and the commands they run:
+  h1    run-h1-final.sh            dpl-config-h1-final.json
+  h2    run-h2-final.sh            dpl-config-h2-final.json
+  h3    run-h3-final.sh            dpl-config-h3-final.json
+  h4    run-h4-3.sh                dpl-config-skimming.json (derived AO2D)
+  jets  Jets/run-jet-spectra.sh    Jets/dpl-config-jets.json
+
+Example:
+  ./Tools/run-synthetic.py --events 10000 --generator-opt "--mult-mean 50" h1 h3
+"""
+
+import argparse
+import importlib.util
+import json
+import os
+import shlex
+import subprocess
+import sys
+
+REPO_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+GENERATOR = "o2-analysistutorial-synthetic-ao2d"
+
+RUN3_MC_EVENT_SELECTION = {
+    "bc-selection-task": {"processRun2": "false", "processRun3": "true"},
+    "event-selection-task": {"syst": "pp", "isMC": "true", "processRun2": "false", "processRun3": "true"},
+    "multiplicity-table": {"processRun2": "false", "processRun3": "true"},
+}
+
+# script, dpl-config, configuration overrides, histogram counting the events
+CHAINS = {
+    "h1": ("run-h1-final.sh", "dpl-config-h1-final.json", {}, "momentumresolution/hVertexZ"),
+    "h2": ("run-h2-final.sh", "dpl-config-h2-final.json", {}, "twoparcorcombexample/hVertexZ"),
+    "h3": (
+        "run-h3-final.sh",
+        "dpl-config-h3-final.json",
+        dict(
+            RUN3_MC_EVENT_SELECTION,
+            vzeromcexample={"requireSel7": "false", "requireSel8": "true", "processRun2": "false", "processRun3": "true"},
+        ),
+        "vzeromcexample/hVertexZ",
+    ),
+    "h4": ("run-h4-3.sh", "dpl-config-skimming.json", {}, None),
+    "jets": ("Jets/run-jet-spectra.sh", "Jets/dpl-config-jets.json", {}, None),
+}
+
+
+def load_absolute_paths():
+    spec = importlib.util.spec_from_file_location("batch_run", os.path.join(REPO_DIR, "Tools", "batch-run.py"))
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module.absolute_paths
+
+
+def synthetic_config(config_file, overrides, output):
+    """Copy of the configuration, in another directory, with the overrides"""
+    with open(config_file) as f:
+        config = load_absolute_paths()(json.load(f), os.path.dirname(config_file))
+    overrides = dict(overrides, **{"timestamp-task": {"rct-path": "RCT/Info/RunInformation"}})
+    for device, options in overrides.items():
+        if not isinstance(config.get(device), dict):
+            config[device] = {}
+        config[device].update(options)
+    with open(output, "w") as f:
+        json.dump(config, f, indent=4)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("chains", nargs="+", choices=sorted(CHAINS), help="chains to run")
+    parser.add_argument("-i", "--input", default="AO2D-synthetic.root", help="synthetic AO2D file, generated if it does not exist")
+    parser.add_argument("-n", "--events", type=int, default=1000, help="collisions of the generated file")
+    parser.add_argument("--generator-opt", default="", help="extra options of the generator, e.g. \"--mult-mean 50 --run-number 526641\"")
+    parser.add_argument("-w", "--work-dir", default="synthetic-runs", help="directory of the chains")
+    parser.add_argument("--extra-opt", default="", help="extra DPL options for every pipeline")
+    args = parser.parse_args()
+
+    input_file = os.path.abspath(args.input)
+    if not os.path.exists(input_file):
+        command = [GENERATOR, "--output", input_file, "--events", str(args.events)] + shlex.split(args.generator_opt)
+        print(" ".join(command), flush=True)
+        if subprocess.run(command).returncode != 0:
+            print(f"{GENERATOR} failed")
+            return 1
+
+    failed = []
+    for chain in args.chains:
+        script, config, overrides, event_histogram = CHAINS[chain]
+        chain_dir = os.path.abspath(os.path.join(args.work_dir, chain))
+        os.makedirs(chain_dir, exist_ok=True)
+        config_file = os.path.join(chain_dir, "dpl-config.json")
+        synthetic_config(os.path.join(REPO_DIR, config), overrides, config_file)
+        files = os.path.join(chain_dir, "files.txt")
+        with open(files, "w") as f:
+            f.write(input_file + "\n")
+
+        command = [sys.executable, os.path.join(REPO_DIR, "Tools", "batch-run.py"), os.path.join(REPO_DIR, script)]
+        command += ["--files", files, "--config", config_file, "-j", "1", "--retries", "0"]
+        command += ["-w", os.path.join(chain_dir, "shards"), "-o", os.path.join(chain_dir, "merged"), "--report", os.path.join(chain_dir, "report.json")]
+        if event_histogram:
+            command += ["--event-histogram", event_histogram]
+        if args.extra_opt:
+            command += ["--extra-opt", args.extra_opt]
+        print(f"--- {chain}: {' '.join(command)}", flush=True)
+        if subprocess.run(command).returncode != 0:
+            failed.append(chain)
+
+    if failed:
+        print(f"failed chains: {', '.join(failed)}, see {args.work_dir}/<chain>/shards/shard-0/0/log.txt")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
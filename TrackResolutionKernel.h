@@ -0,0 +1,93 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file TrackResolutionKernel.h
+/// \brief Column-wise track selection and pT resolution of
+///        momentumresolution::processColumnar (h1), over plain column
+///        pointers: a selection bitmask built branch free, 64 rows per word,
+///        the selected rows visited in order, and the MC particles read in
+///        increasing label order. Shared with the kernel benchmarks.
+/// \author
+/// \since
+
+#ifndef TRACKRESOLUTIONKERNEL_H_
+#define TRACKRESOLUTIONKERNEL_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace o2::analysis::hadrex
+{
+
+class TrackResolutionKernel
+{
+ public:
+  /// Builds the selection bitmask: tracks with a collision (the grouped path
+  /// does not see the others), at least 70 crossed TPC rows and |DCAxy| <= 0.2 cm
+  void select(const uint8_t* tpcNClsFindable, const int8_t* tpcNClsFindableMinusCrossedRows, const float* dcaXY, const int32_t* collisionId, int64_t nTracks)
+  {
+    mSelectionMask.assign((nTracks + 63) / 64, 0);
+    for (int64_t word = 0; word < static_cast<int64_t>(mSelectionMask.size()); ++word) {
+      const int64_t first = word * 64;
+      const int64_t last = std::min(first + 64, nTracks);
+      uint64_t bits = 0;
+      for (int64_t row = first; row < last; ++row) {
+        int crossedRows = tpcNClsFindable[row] - tpcNClsFindableMinusCrossedRows[row];
+        bool selected = (collisionId[row] >= 0) & (crossedRows >= 70) & (std::fabs(dcaXY[row]) <= .2);
+        bits |= static_cast<uint64_t>(selected) << (row - first);
+      }
+      mSelectionMask[word] = bits;
+    }
+  }
+
+  /// Calls fillTrack(row) for the selected rows in increasing order and keeps
+  /// the MC label and pT of those with a label; returns the selected rows
+  template <typename F>
+  uint64_t compact(const float* pt, const int32_t* mcParticleId, F&& fillTrack)
+  {
+    mLabelAndPt.clear();
+    uint64_t nSelected = 0;
+    for (int64_t word = 0; word < static_cast<int64_t>(mSelectionMask.size()); ++word) {
+      nSelected += __builtin_popcountll(mSelectionMask[word]);
+      for (uint64_t bits = mSelectionMask[word]; bits != 0; bits &= bits - 1) {
+        int64_t row = word * 64 + __builtin_ctzll(bits);
+        fillTrack(row);
+        if (mcParticleId[row] >= 0) {
+          mLabelAndPt.emplace_back(mcParticleId[row], pt[row]);
+        }
+      }
+    }
+    return nSelected;
+  }
+
+  /// Calls fillResolution(pt, pt - pt of the MC particle) for the labelled
+  /// tracks kept by compact(), in one pass over the MC particles in
+  /// increasing index order. mcTruth must be up to date for the dataframe
+  template <typename TMcTruth, typename F>
+  void resolve(TMcTruth const& mcTruth, F&& fillResolution)
+  {
+    std::sort(mLabelAndPt.begin(), mLabelAndPt.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+    for (auto const& [label, trackPt] : mLabelAndPt) {
+      fillResolution(trackPt, trackPt - mcTruth.pt(label));
+    }
+  }
+
+ private:
+  std::vector<uint64_t> mSelectionMask;
+  std::vector<std::pair<int32_t, float>> mLabelAndPt;
+};
+
+} // namespace o2::analysis::hadrex
+
+#endif // TRACKRESOLUTIONKERNEL_H_
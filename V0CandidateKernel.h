@@ -0,0 +1,72 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file V0CandidateKernel.h
+/// \brief V0 selection and mass filling of vzeromcexample (h3) on plain
+///        values: the TPC PID hypotheses, the MC true species and the mass
+///        histograms they select. The topological cuts are the Filters of
+///        the task. Shared with the kernel benchmarks.
+/// \author
+/// \since
+
+#ifndef V0CANDIDATEKERNEL_H_
+#define V0CANDIDATEKERNEL_H_
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace o2::analysis::hadrex
+{
+
+enum V0Species {
+  kK0Short = 0,
+  kLambda,
+  kAntiLambda,
+  nV0Species
+};
+
+/// PID hypotheses K0S, Lambda and AntiLambda: both daughters within 4 sigma
+/// of the TPC response. The n sigma are passed as the task reads them
+inline std::array<bool, nV0Species> v0PidHypotheses(float nSigmaPosProton, float nSigmaNegProton, float nSigmaPosPion, float nSigmaNegPion)
+{
+  nSigmaPosProton = std::abs(nSigmaPosProton);
+  nSigmaNegProton = std::abs(nSigmaNegProton);
+  nSigmaPosPion = std::abs(nSigmaPosPion);
+  nSigmaNegPion = std::abs(nSigmaNegPion);
+  return {nSigmaPosPion < 4 && nSigmaNegPion < 4, nSigmaPosProton < 4 && nSigmaNegPion < 4, nSigmaPosPion < 4 && nSigmaNegProton < 4};
+}
+
+/// MC true species of a PDG code (0 if no association was made), -1 if none of the three
+inline int v0TrueSpecies(int32_t pdgCode)
+{
+  return pdgCode == 310 ? kK0Short : pdgCode == 3122 ? kLambda : pdgCode == -3122 ? kAntiLambda : -1;
+}
+
+/// Fills the mass of every PID hypothesis passed into hMass and the mass of
+/// the MC true species into hMassTrue; THistogram is any pointer to a TH1
+template <typename THistogram>
+void fillV0Masses(std::array<bool, nV0Species> const& pid, std::array<float, nV0Species> const& mass, int trueSpecies,
+                  std::array<THistogram, nV0Species> const& hMass, std::array<THistogram, nV0Species> const& hMassTrue)
+{
+  for (int iSpecies = 0; iSpecies < nV0Species; ++iSpecies) {
+    if (pid[iSpecies]) {
+      hMass[iSpecies]->Fill(mass[iSpecies]);
+    }
+  }
+  if (trueSpecies >= 0) {
+    hMassTrue[trueSpecies]->Fill(mass[trueSpecies]);
+  }
+}
+
+} // namespace o2::analysis::hadrex
+
+#endif // V0CANDIDATEKERNEL_H_
@@ -19,9 +19,18 @@
 #include "Framework/runDataProcessing.h"
 #include "Framework/AnalysisTask.h"
 #include "Common/DataModel/TrackSelectionTables.h"
+#include "ColumnReader.h"
+#include "FillBuffer.h"
+#include "McTruthCache.h"
+#include "ProcessProfiler.h"
+#include "ResolutionAccumulator.h"
+#include "TrackResolutionKernel.h"
 
 using namespace o2;
 using namespace o2::framework;
+using namespace o2::analysis::hadrex;
+
+using MyLabeledTracks = soa::Join<aod::Tracks, aod::TracksExtra, aod::TracksDCA, aod::McTrackLabels>;
 
 //STEP 7
 //This more sophisticated example exemplifies the access of MC information
@@ -36,6 +45,10 @@ struct momentumresolution {
   //Configurable for number of bins
   Configurable<int> nBinsEta{"nBinsEta", 100, "N bins in eta histo"};
   Configurable<int> nBinsPt{"nBinsPt", 100, "N bins in pT histo"};
+  //pT resolution as a TH2F and/or as streaming statistics per pT bin
+  Configurable<bool> fillResoHistogram{"fillResoHistogram", true, "Fill the pT x delta pT resoHistogram"};
+  Configurable<bool> accumulateResolution{"accumulateResolution", false, "Keep mean, RMS and quantiles of delta pT per pT bin (resolution/)"};
+  Configurable<int> nBinsPtResolution{"nBinsPtResolution", 100, "N pT bins of the resolution accumulators"};
   
   // histogram defined with HistogramRegistry
   HistogramRegistry registry
@@ -43,30 +56,155 @@ struct momentumresolution {
     "registry", {},
   };
 
+  // per-process timing and row counters, written at end of stream
+  ProcessProfiler profiler;
+
+  // track histograms are filled through buffers merged once per dataframe
+  FillBuffer1D etaBuffer;
+  FillBuffer1D ptBuffer;
+  FillBuffer2D resoBuffer;
+
+  // count, mean, variance and quantiles of delta pT per pT bin
+  ResolutionAccumulator resolution;
+
+  // dense copy of the MC particle truth, rebuilt once per dataframe
+  McTruthCache mcTruth;
+
+  // scratch arrays, reused across collisions and dataframes
+  std::vector<int32_t> selectedLabels;
+  std::vector<float> selectedPt;
+  std::vector<float> selectedMcPt;
+
+  // selection bitmask and labelled tracks of processColumnar
+  TrackResolutionKernel columnarKernel;
+
   void init(InitContext const&)
   {
     registry.add("hVertexZ", "hVertexZ", {HistType::kTH1F, {{120, -15., 15.}}});
     registry.add("etaHistogram", "etaHistogram", {HistType::kTH1F, {{nBinsEta, -1., +1}}});
     registry.add("ptHistogram", "ptHistogram", {HistType::kTH1F, {{nBinsPt, 0., 10.0}}});
-    registry.add("resoHistogram", "resoHistogram", {HistType::kTH2F, {{nBinsPt, 0., 10.0}, {100, -.5, .5}}});
+    if (fillResoHistogram) {
+      registry.add("resoHistogram", "resoHistogram", {HistType::kTH2F, {{nBinsPt, 0., 10.0}, {100, -.5, .5}}});
+    }
+    if (accumulateResolution) {
+      for (auto name : {"entries", "mean", "stdDev", "sigma68", "sigma95", "q025", "q16", "q84", "q975"}) {
+        registry.add((std::string("resolution/") + name).c_str(), name, {HistType::kTH1D, {{nBinsPtResolution, 0., 10.0}}});
+      }
+      resolution.setBinning(nBinsPtResolution, 0., 10.0);
+    }
+    profiler.init(registry, {"processPerCollision", "processColumnar"});
+    if (doprocessPerCollision && doprocessColumnar) {
+      LOGF(fatal, "processPerCollision and processColumnar fill the same histograms, enable only one of them");
+    }
+    etaBuffer.attach(registry.get<TH1>(HIST("etaHistogram")));
+    ptBuffer.attach(registry.get<TH1>(HIST("ptHistogram")));
+    if (fillResoHistogram) {
+      resoBuffer.attach(registry.get<TH2>(HIST("resoHistogram")));
+    }
   };
 
-  void process(aod::Collision const& collision, soa::Join<aod::Tracks, aod::TracksExtra, aod::TracksDCA, aod::McTrackLabels> const& tracks, aod::McParticles const&)
+  void fillResolution(float pt, float delta)
+  {
+    if (fillResoHistogram) {
+      resoBuffer.fill(pt, delta);
+    }
+    if (accumulateResolution) {
+      resolution.fill(pt, delta);
+    }
+  }
+
+  void flushBuffers()
+  {
+    etaBuffer.flush();
+    ptBuffer.flush();
+    resoBuffer.flush();
+  }
+
+  // run() is called at the start of every dataframe: merge the previous one
+  void run(ProcessingContext&)
   {
+    flushBuffers();
+    mcTruth.invalidate();
+  }
+
+  void endOfStream(EndOfStreamContext&)
+  {
+    flushBuffers();
+    if (accumulateResolution) {
+      resolution.copyTo(registry.get<TH1>(HIST("resolution/entries")).get(), registry.get<TH1>(HIST("resolution/mean")).get(),
+                        registry.get<TH1>(HIST("resolution/stdDev")).get(), registry.get<TH1>(HIST("resolution/sigma68")).get(),
+                        registry.get<TH1>(HIST("resolution/sigma95")).get(),
+                        {registry.get<TH1>(HIST("resolution/q025")).get(), registry.get<TH1>(HIST("resolution/q16")).get(),
+                         registry.get<TH1>(HIST("resolution/q84")).get(), registry.get<TH1>(HIST("resolution/q975")).get()});
+    }
+    profiler.write();
+  }
+
+  void processPerCollision(aod::Collision const& collision, MyLabeledTracks const& tracks, aod::McParticles const& mcParticles)
+  {
+    auto profile = profiler.measure(0, tracks.size());
     registry.get<TH1>(HIST("hVertexZ"))->Fill(collision.posZ());
     //This will take place once per event!
+    selectedLabels.clear();
+    selectedPt.clear();
     for (auto& track : tracks) {
       if( track.tpcNClsCrossedRows() < 70 ) continue; //skip stuff not tracked well by TPC
       if( fabs(track.dcaXY()) > .2 ) continue; //skip stuff that doesn't point to PV (example, can be elaborate!)
-      registry.get<TH1>(HIST("etaHistogram"))->Fill(track.eta());
-      registry.get<TH1>(HIST("ptHistogram"))->Fill(track.pt());
-      
-      //Resolve MC track - no need to touch index!
-      auto mcParticle = track.mcParticle_as<aod::McParticles>();
-      float delta = track.pt() - mcParticle.pt() ;
-      registry.get<TH2>(HIST("resoHistogram"))->Fill(track.pt(), delta);
+      etaBuffer.fill(track.eta());
+      ptBuffer.fill(track.pt());
+      selectedLabels.push_back(track.mcParticleId());
+      selectedPt.push_back(track.pt());
+    }
+
+    //Resolve the MC particles of all selected tracks in one gather
+    mcTruth.update(mcParticles);
+    selectedMcPt.resize(selectedLabels.size());
+    mcTruth.gatherPt(selectedLabels.data(), selectedLabels.size(), selectedMcPt.data());
+    for (std::size_t i = 0; i < selectedLabels.size(); ++i) {
+      if (selectedLabels[i] < 0) continue; //no MC particle associated
+      float delta = selectedPt[i] - selectedMcPt[i];
+      fillResolution(selectedPt[i], delta);
+    }
+    profile.addRowsOut(selectedLabels.size());
+  }
+  PROCESS_SWITCH(momentumresolution, processPerCollision, "Track loop grouped per collision", true);
+
+  //Same selection and histograms, computed once per dataframe over the
+  //full track table: the selection is a bitmask built from the columns,
+  //MC particles are gathered in increasing label order
+  void processColumnar(aod::Collisions const& collisions, MyLabeledTracks const& tracks, aod::McParticles const& mcParticles)
+  {
+    auto profile = profiler.measure(1, tracks.size());
+    auto collisionTable = collisions.asArrowTable();
+    ColumnReader<float> posZ(*collisionTable, "fPosZ");
+    for (int64_t i = 0; i < posZ.size(); ++i) {
+      registry.get<TH1>(HIST("hVertexZ"))->Fill(posZ[i]);
     }
+
+    auto trackTable = tracks.asArrowTable();
+    ColumnReader<uint8_t> tpcNClsFindable(*trackTable, "fTPCNClsFindable");
+    ColumnReader<int8_t> tpcNClsFindableMinusCrossedRows(*trackTable, "fTPCNClsFindableMinusCrossedRows");
+    ColumnReader<float> dcaXY(*trackTable, "fDcaXY");
+    ColumnReader<float> eta(*trackTable, "fEta");
+    ColumnReader<float> pt(*trackTable, "fPt");
+    ColumnReader<int32_t> collisionId(*trackTable, "fIndexCollisions");
+    ColumnReader<int32_t> mcParticleId(*trackTable, "fIndexMcParticles");
+
+    //selection bitmask, 64 rows per word
+    columnarKernel.select(tpcNClsFindable.data(), tpcNClsFindableMinusCrossedRows.data(), dcaXY.data(), collisionId.data(), trackTable->num_rows());
+
+    //compaction: fill the selected rows and collect their MC labels
+    uint64_t nSelected = columnarKernel.compact(pt.data(), mcParticleId.data(), [&](int64_t row) {
+      etaBuffer.fill(eta[row]);
+      ptBuffer.fill(pt[row]);
+    });
+
+    //one pass over the MC particles in increasing index order
+    mcTruth.update(mcParticles);
+    columnarKernel.resolve(mcTruth, [&](float trackPt, float deltaPt) { fillResolution(trackPt, deltaPt); });
+    profile.addRowsOut(nSelected);
   }
+  PROCESS_SWITCH(momentumresolution, processColumnar, "Column-wise selection over the full track table", false);
 };
 
 WorkflowSpec defineDataProcessing(ConfigContext const& cfgc)
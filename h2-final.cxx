@@ -19,11 +19,16 @@
 #include "Framework/AnalysisTask.h"
 #include "Common/DataModel/TrackSelectionTables.h"
 #include "Framework/ASoAHelpers.h"
-#include <iostream>
+#include "CorrelationContainer.h"
+#include "CorrelationEngine.h"
+#include "MixedEventPool.h"
+#include "ProcessProfiler.h"
+#include "SkipCounter.h"
 
 using namespace o2;
 using namespace o2::framework;
 using namespace o2::framework::expressions;
+using namespace o2::analysis::hadrex;
 
 //This is an example of a conveient declaration of "using"
 using MyCompleteTracks = soa::Join<aod::Tracks, aod::TracksExtra, aod::TracksDCA>;
@@ -35,9 +40,12 @@ using MyCompleteTracks = soa::Join<aod::Tracks, aod::TracksExtra, aod::TracksDCA
 //that is in principle more efficient.
 struct twoparcorcombexample {
   
-  //using MyCollisions = aod::Collisions;
-  //Filter colFilter = aod::collision::posZ < 10.0f && aod::collision::posZ > -10.0f;
-  //using MyFilteredCollisions = soa::Filtered<aod::Collisions>;//MyCollisions>;
+  //Collision selection, evaluated column-wise: the tracks and the partitions
+  //are only grouped for the collisions passing it
+  Configurable<float> maxVertexZ{"maxVertexZ", 1000.0f, "Maximum |z| of the collision vertex (1000: no cut)"};
+  Filter colFilter = nabs(aod::collision::posZ) < maxVertexZ;
+  using MyFilteredCollisions = soa::Filtered<aod::Collisions>;
+  SkipCounter skipCounter;
 
   // all defined filters are applied
   Filter trackFilter = nabs(aod::track::eta) < 0.8f && aod::track::pt > 2.0f;
@@ -53,31 +61,36 @@ struct twoparcorcombexample {
     "registry", {}
   };
   
-  Double_t ComputeDeltaPhi( Double_t phi1, Double_t phi2) {
-      //To be completely sure, use inner products
-      Double_t x1, y1, x2, y2;
-      x1 = TMath::Cos( phi1 );
-      y1 = TMath::Sin( phi1 );
-      x2 = TMath::Cos( phi2 );
-      y2 = TMath::Sin( phi2 );
-      Double_t lInnerProd  = x1*x2 + y1*y2;
-      Double_t lVectorProd = x1*y2 - x2*y1;
-      
-      Double_t lReturnVal = 0;
-      if( lVectorProd > 1e-8 ) {
-          lReturnVal = TMath::ACos(lInnerProd);
-      }
-      if( lVectorProd < -1e-8 ) {
-          lReturnVal = -TMath::ACos(lInnerProd);
-      }
-      
-      if( lReturnVal < -TMath::Pi()/2. ) {
-          lReturnVal += 2.*TMath::Pi();
-      }
-      
-      return lReturnVal;
-  }
-  
+  //Configurable to cross-check the pair kernel against ComputeDeltaPhi
+  Configurable<bool> validateKernel{"validateKernel", false, "Compare pair kernel with ComputeDeltaPhi bin by bin"};
+
+  //Per-collision contiguous copies of the trigger and associated populations
+  ParticleArrays triggerArrays;
+  ParticleArrays assocArrays;
+  CorrelationEngine correlationEngine;
+  std::vector<uint32_t> referenceCounts;
+
+  //Mixed-event correlations, filled in the same pass as the same-event ones
+  Configurable<bool> doMixing{"doMixing", false, "Fill mixed-event correlation function"};
+  Configurable<int> mixingPoolDepth{"mixingPoolDepth", 5, "Events kept per vertex z / multiplicity bin"};
+  Configurable<std::vector<float>> mixingBinsVtxZ{"mixingBinsVtxZ", {-10.f, -5.f, 0.f, 5.f, 10.f}, "Vertex z bin edges for mixing"};
+  Configurable<std::vector<float>> mixingBinsMult{"mixingBinsMult", {0.f, 5.f, 10.f, 20.f, 50.f, 1000.f}, "Multiplicity (selected tracks) bin edges for mixing"};
+  MixedEventPool mixingPool;
+  CorrelationEngine mixedEngine;
+
+  //Delta eta x delta phi correlations in trigger x associate pT bins, counted
+  //in a flat container and copied to one TH2 per pT bin pair at the end
+  ConfigurableAxis axisPtTrig{"axisPtTrig", {VARIABLE_WIDTH, 4.0, 6.0, 8.0, 10.0}, "Trigger pT bins"};
+  ConfigurableAxis axisPtAssoc{"axisPtAssoc", {VARIABLE_WIDTH, 2.0, 3.0, 4.0, 6.0}, "Associate pT bins"};
+  ConfigurableAxis axisDeltaEta{"axisDeltaEta", {32, -1.6, 1.6}, "Delta eta bins (fixed width)"};
+  ConfigurableAxis axisDeltaPhi{"axisDeltaPhi", {36, -0.5 * M_PI, 1.5 * M_PI}, "Delta phi bins (fixed width, 2pi range)"};
+  CorrelationContainer correlationContainer;
+  std::vector<std::shared_ptr<TH2>> hMultiDim;
+  std::vector<float> multiDimPt, multiDimEta, multiDimPhi;
+
+  //Per-process timing and row counters (rows out are same-event pairs)
+  ProcessProfiler profiler;
+
   void init(InitContext const&)
   {
     registry.add("hVertexZ", "hVertexZ", {HistType::kTH1F, {{nBins, -15., 15.}}});
@@ -86,19 +99,99 @@ struct twoparcorcombexample {
     registry.add("etaHistogramAssoc", "etaHistogramAssoc", {HistType::kTH1F, {{nBins, -1., +1}}});
     registry.add("ptHistogramAssoc", "ptHistogramAssoc", {HistType::kTH1F, {{nBins, 0., 10.0}}});
     registry.add("correlationFunction", "correlationFunction", {HistType::kTH1F, {{40,-0.5*M_PI, 1.5*M_PI}}});
+    correlationEngine.setBinning(40, -0.5 * M_PI, 1.5 * M_PI);
+
+    if (validateKernel) {
+      registry.add("correlationFunctionReference", "correlationFunctionReference", {HistType::kTH1F, {{40, -0.5 * M_PI, 1.5 * M_PI}}});
+      auto hValidation = registry.add<TH1>("hKernelValidation", "hKernelValidation", {HistType::kTH1D, {{4, -0.5, 3.5}}});
+      hValidation->GetXaxis()->SetBinLabel(1, "pairs compared");
+      hValidation->GetXaxis()->SetBinLabel(2, "bins compared");
+      hValidation->GetXaxis()->SetBinLabel(3, "bins mismatched");
+      hValidation->GetXaxis()->SetBinLabel(4, "antiparallel pairs at 0");
+      referenceCounts.assign(correlationEngine.counts().size(), 0);
+    }
+
+    if (doMixing) {
+      registry.add("correlationFunctionMixed", "correlationFunctionMixed", {HistType::kTH1F, {{40, -0.5 * M_PI, 1.5 * M_PI}}});
+      registry.add("hMixedEvents", "hMixedEvents", {HistType::kTH1F, {{mixingPoolDepth + 1, -0.5, mixingPoolDepth + 0.5}}});
+      mixedEngine.setBinning(40, -0.5 * M_PI, 1.5 * M_PI);
+      mixingPool.setBinning(mixingBinsVtxZ.value, mixingBinsMult.value, mixingPoolDepth);
+    }
+    if (doprocessMultiDim) {
+      correlationContainer.setAxes(axisPtTrig.value, axisPtAssoc.value, axisDeltaEta.value, axisDeltaPhi.value);
+      auto const& ptTrig = correlationContainer.ptTrigAxis();
+      auto const& ptAssoc = correlationContainer.ptAssocAxis();
+      auto const& deltaEta = correlationContainer.deltaEtaAxis();
+      auto const& deltaPhi = correlationContainer.deltaPhiAxis();
+      registry.add("multiDim/hTriggers", "hTriggers;#it{p}_{T}^{trig} (GeV/#it{c})", {HistType::kTH1D, {{ptTrig.edges()}}});
+      for (int iTrig = 0; iTrig < ptTrig.nBins(); ++iTrig) {
+        for (int iAssoc = 0; iAssoc < ptAssoc.nBins(); ++iAssoc) {
+          auto name = "multiDim/sameEvent_" + std::to_string(iTrig) + "_" + std::to_string(iAssoc);
+          auto title = Form("%.1f < #it{p}_{T}^{trig} < %.1f, %.1f < #it{p}_{T}^{assoc} < %.1f;#Delta#eta;#Delta#varphi", ptTrig.edges()[iTrig], ptTrig.edges()[iTrig + 1], ptAssoc.edges()[iAssoc], ptAssoc.edges()[iAssoc + 1]);
+          hMultiDim.push_back(registry.add<TH2>(name.c_str(), title, {HistType::kTH2D, {{deltaEta.nBins(), deltaEta.min(), deltaEta.max()}, {deltaPhi.nBins(), deltaPhi.min(), deltaPhi.max()}}}));
+        }
+      }
+    }
+    profiler.init(registry, {"processDeltaPhi", "processMultiDim"});
+    if (doprocessSkipCounter) {
+      skipCounter.init(registry, "tracks");
+    }
+  }
+
+  void endOfStream(EndOfStreamContext&)
+  {
+    if (doprocessMultiDim) {
+      const int nAssocBins = correlationContainer.ptAssocAxis().nBins();
+      for (std::size_t i = 0; i < hMultiDim.size(); ++i) {
+        correlationContainer.copyTo(i / nAssocBins, i % nAssocBins, hMultiDim[i].get());
+      }
+      correlationContainer.copyTriggersTo(registry.get<TH1>(HIST("multiDim/hTriggers")).get());
+    }
+    profiler.write();
   }
 
-  int socorro = 0;
+  //Fills the tutorial ComputeDeltaPhi result for the same pairs and counts
+  //the bins in which it differs from the pair kernel. The tutorial returns 0
+  //for antiparallel pairs, which the kernel puts at pi: this known
+  //difference is counted on its own and these pairs are compared at pi
+  void validatePairKernel()
+  {
+    auto hReference = registry.get<TH1>(HIST("correlationFunctionReference"));
+    std::fill(referenceCounts.begin(), referenceCounts.end(), 0);
+    int nAntiparallel = 0;
+    for (std::size_t iTrig = 0; iTrig < triggerArrays.size(); ++iTrig) {
+      for (std::size_t iAssoc = 0; iAssoc < assocArrays.size(); ++iAssoc) {
+        double deltaPhi = computeDeltaPhiReference(triggerArrays.phi[iTrig], assocArrays.phi[iAssoc]);
+        hReference->Fill(deltaPhi);
+        if (deltaPhi == 0. && isAntiparallelReference(triggerArrays.phi[iTrig], assocArrays.phi[iAssoc])) {
+          nAntiparallel++;
+          deltaPhi = M_PI;
+        }
+        ++referenceCounts[hReference->GetXaxis()->FindFixBin(deltaPhi)];
+      }
+    }
+    auto const& kernelCounts = correlationEngine.counts();
+    int nMismatched = 0;
+    for (std::size_t bin = 0; bin < referenceCounts.size(); ++bin) {
+      if (referenceCounts[bin] != kernelCounts[bin]) {
+        nMismatched++;
+      }
+    }
+    auto hValidation = registry.get<TH1>(HIST("hKernelValidation"));
+    hValidation->Fill(0., static_cast<double>(correlationEngine.nPairs()));
+    hValidation->Fill(1., static_cast<double>(referenceCounts.size()));
+    hValidation->Fill(2., nMismatched);
+    hValidation->Fill(3., nAntiparallel);
+  }
 
-  void process(aod::Collision const& collision, MyFilteredTracks const& tracks) 
+  void processDeltaPhi(MyFilteredCollisions::iterator const& collision, MyFilteredTracks const& tracks)
   {
 
     //Fill the event counter
     //check getter here: https://aliceo2group.github.io/analysis-framework/docs/datamodel/ao2dTables.html
     //for (auto& collision : collisions){
 
-    std::cout << socorro << std::endl;
-    socorro++;
+    auto profile = profiler.measure(0, tracks.size());
 
     //if( fabs(collision.posZ())>10.0f ) continue;
 
@@ -109,22 +202,78 @@ struct twoparcorcombexample {
     auto assocTracksGrouped = assocTracks->sliceByCached(aod::track::collisionId, collision.globalIndex());
 
     //Inspect the trigger and associated populations
+    //and copy the ones passing the TPC requirement to contiguous arrays
+    triggerArrays.clear();
+    assocArrays.clear();
     for (auto& track : triggerTracksGrouped) { //<- only for a subset
       registry.get<TH1>(HIST("etaHistogramTrigger"))->Fill(track.eta()); //<- this should show the selection
       registry.get<TH1>(HIST("ptHistogramTrigger"))->Fill(track.pt());
+      if (track.tpcNClsCrossedRows() < 70) continue; //can't filter on dynamic
+      triggerArrays.push_back(track.phi(), track.eta());
     }
     for (auto& track : assocTracksGrouped) { //<- only for a subset
       registry.get<TH1>(HIST("etaHistogramAssoc"))->Fill(track.eta()); //<- this should show the selection
       registry.get<TH1>(HIST("ptHistogramAssoc"))->Fill(track.pt());
+      if (track.tpcNClsCrossedRows() < 70) continue; //can't filter on dynamic
+      assocArrays.push_back(track.phi(), track.eta());
     }
-    
-    //Now we do two-particle correlations, using "combinations"
-    for (auto& [trackTrigger, trackAssoc] : combinations(o2::soa::CombinationsFullIndexPolicy(triggerTracksGrouped, assocTracksGrouped))) {
-      if(trackTrigger.tpcNClsCrossedRows() < 70 ) continue; //can't filter on dynamic
-      if(trackAssoc.tpcNClsCrossedRows() < 70 ) continue; //can't filter on dynamic
-      registry.get<TH1>(HIST("correlationFunction"))->Fill( ComputeDeltaPhi(trackTrigger.phi(), trackAssoc.phi() ));
+
+    //Now we do two-particle correlations: all trigger x associated pairs,
+    //equivalent to combinations(CombinationsFullIndexPolicy(...)), but binned
+    //locally and flushed into the histogram once per collision
+    correlationEngine.correlate(triggerArrays, assocArrays);
+    if (validateKernel) {
+      validatePairKernel();
     }
+    profile.addRowsOut(correlationEngine.nPairs());
+    correlationEngine.flush(registry.get<TH1>(HIST("correlationFunction")).get());
+
+    //Mix the triggers of this event with the associated tracks of the
+    //previous events in the same pool bin, then add this event to the pool
+    if (doMixing) {
+      int poolBin = mixingPool.findBin(collision.posZ(), tracks.size());
+      if (poolBin >= 0) {
+        registry.fill(HIST("hMixedEvents"), mixingPool.nEvents(poolBin));
+        mixingPool.forEachEvent(poolBin, [this](ParticleArrays const& pooledAssociates) {
+          mixedEngine.correlate(triggerArrays, pooledAssociates);
+        });
+        mixedEngine.flush(registry.get<TH1>(HIST("correlationFunctionMixed")).get());
+        mixingPool.push(poolBin, assocArrays);
+      }
+    }
+  }
+  PROCESS_SWITCH(twoparcorcombexample, processDeltaPhi, "Delta phi correlation of the pT > 4 and pT < 4 GeV/c partitions", true);
+
+  //Every selected track is a trigger and an associate candidate, binned by
+  //the pT axes; a track is not paired with itself
+  void processMultiDim(MyFilteredCollisions::iterator const& collision, MyFilteredTracks const& tracks)
+  {
+    auto profile = profiler.measure(1, tracks.size());
+    if (!doprocessDeltaPhi) {
+      registry.get<TH1>(HIST("hVertexZ"))->Fill(collision.posZ());
+    }
+    multiDimPt.clear();
+    multiDimEta.clear();
+    multiDimPhi.clear();
+    for (auto& track : tracks) {
+      if (track.tpcNClsCrossedRows() < 70) continue; //can't filter on dynamic
+      multiDimPt.push_back(track.pt());
+      multiDimEta.push_back(track.eta());
+      multiDimPhi.push_back(track.phi());
+    }
+    uint64_t nPairsBefore = correlationContainer.nPairs();
+    correlationContainer.fill(multiDimPt.data(), multiDimEta.data(), multiDimPhi.data(), multiDimPt.size());
+    profile.addRowsOut(correlationContainer.nPairs() - nPairsBefore);
   }
+  PROCESS_SWITCH(twoparcorcombexample, processMultiDim, "Delta eta x delta phi correlations in trigger x associate pT bins", false);
+
+  //once per dataframe: collisions rejected by colFilter and their tracks
+  void processSkipCounter(MyFilteredCollisions const& collisions, aod::Tracks const& tracks)
+  {
+    skipCounter.count(collisions, tracks);
+  }
+  PROCESS_SWITCH(twoparcorcombexample, processSkipCounter, "Count the collisions and tracks skipped by the vertex selection", true);
+
   //}
 };
 
@@ -19,17 +19,63 @@
 #include "PWGLF/DataModel/LFStrangenessTables.h"
 #include "Common/DataModel/EventSelection.h"
 #include "Common/DataModel/PIDResponse.h"
+#include "McTruthCache.h"
+#include "ProcessProfiler.h"
+#include "SkipCounter.h"
+#include "V0CandidateKernel.h"
 
 using namespace o2;
 using namespace o2::framework;
 using namespace o2::framework::expressions;
+using namespace o2::analysis::hadrex;
+
+//V0 topological variables materialized as stored columns, so that they can
+//be used in a Filter (cosPA and radius of V0Datas are dynamic columns)
+namespace o2::aod
+{
+namespace v0topology
+{
+DECLARE_SOA_COLUMN(CosPA, cosPA, double);  //! cosine of pointing angle w.r.t. the V0 collision vertex
+DECLARE_SOA_COLUMN(Radius, radius, float); //! transverse decay radius
+} // namespace v0topology
+
+DECLARE_SOA_TABLE(V0Topologies, "AOD", "V0TOPOLOGY", //! joinable with V0Datas
+                  v0topology::CosPA,
+                  v0topology::Radius);
+} // namespace o2::aod
+
+//Produces one V0Topologies row per V0Datas row
+struct v0topologybuilder {
+  Produces<aod::V0Topologies> v0topologies;
+
+  void process(aod::Collisions const&, aod::V0Datas const& v0s)
+  {
+    for (auto& v0 : v0s) {
+      auto collision = v0.collision();
+      v0topologies(v0.v0cosPA(collision.posX(), collision.posY(), collision.posZ()), v0.v0radius());
+    }
+  }
+};
 
 //STEP 5
 //Use MC label of V0s to fill pid histograms 
 //based on MC true information
 using MyTracksRun2 = soa::Join<aod::Tracks, aod::TracksExtra, aod::TracksCov, aod::TracksDCA, aod::pidTPCPi, aod::pidTPCPr>;
 using MyTracksRun3 = soa::Join<aod::TracksIU, aod::TracksExtra, aod::TracksCovIU, aod::TracksDCA, aod::pidTPCPi, aod::pidTPCPr>;
-using LabeledV0s = soa::Join<aod::V0Datas, aod::McV0Labels>;
+using LabeledV0s = soa::Join<aod::V0Datas, aod::McV0Labels, aod::V0Topologies>;
+using SelectedCollisions = soa::Filtered<soa::Join<aod::Collisions, aod::EvSels>>;
+
+//Default grid of the cut scan mode: one cut set per row
+namespace v0scan
+{
+static constexpr int nCutVars = 5;
+static constexpr int nDefaultCutSets = 3;
+static constexpr float defaultCutSets[nDefaultCutSets][nCutVars] = {{0.97f, 1.0f, 0.1f, 0.1f, 0.5f},
+                                                                    {0.98f, 0.8f, 0.1f, 0.1f, 0.8f},
+                                                                    {0.99f, 0.5f, 0.1f, 0.1f, 1.2f}};
+static const std::vector<std::string> labelsCutSets{"set 0", "set 1", "set 2"};
+static const std::vector<std::string> labelsCutVars{"v0cospa", "dcav0dau", "dcanegtopv", "dcapostopv", "v0radius"};
+} // namespace v0scan
 
 struct vzeromcexample {
   //Configurable for number of bins
@@ -42,8 +88,24 @@ struct vzeromcexample {
   Configurable<float> dcapostopv{"dcapostopv", .1, "DCA Pos To PV"};
   Configurable<float> v0radius{"v0radius", 0.5, "v0radius"};
 
-  //Cannot filter on dynamic columns, so we cut on DCA to PV and DCA between daus only!
+  //Cannot filter on dynamic columns, so cosPA and radius are taken from the materialized V0Topologies
   Filter preFilterV0 = nabs(aod::v0data::dcapostopv) > dcapostopv&& nabs(aod::v0data::dcanegtopv) > dcanegtopv&& aod::v0data::dcaV0daughters < dcav0dau;
+  Filter topologyFilterV0 = aod::v0topology::cosPA > v0cospa&& aod::v0topology::radius > v0radius;
+
+  // Event selection, evaluated column-wise on the collisions: V0s are only
+  // grouped for the collisions passing it. (sel == true || sel == require)
+  // is sel when require is true and always true otherwise. The Filter is
+  // shared by all process functions, so requireSel7 / requireSel8 must match
+  // the enabled Run 2 / Run 3 ones (checked in init). The default vertex cut
+  // of 1000 cm keeps every collision, as before the Filter
+  Configurable<bool> requireSel7{"requireSel7", false, "Require sel7 (Run 2), must be set with processRun2 / processScanRun2"};
+  Configurable<bool> requireSel8{"requireSel8", true, "Require sel8 (Run 3), must be set with processRun3 / processScanRun3"};
+  Configurable<float> maxVertexZ{"maxVertexZ", 1000.0f, "Maximum |z| of the collision vertex (1000: no cut)"};
+  Filter collisionFilter = nabs(aod::collision::posZ) < maxVertexZ && (aod::evsel::sel7 == true || aod::evsel::sel7 == requireSel7) && (aod::evsel::sel8 == true || aod::evsel::sel8 == requireSel8);
+  SkipCounter skipCounter;
+
+  // Scan mode: every V0 is tested against all cut sets in one pass
+  Configurable<LabeledArray<float>> cutScanGrid{"cutScanGrid", {v0scan::defaultCutSets[0], v0scan::nDefaultCutSets, v0scan::nCutVars, v0scan::labelsCutSets, v0scan::labelsCutVars}, "V0 cut sets for the scan mode, one per row"};
   
   // histogram defined with HistogramRegistry
   HistogramRegistry registry{
@@ -59,75 +121,223 @@ struct vzeromcexample {
     }
   };
   
+  // per-process timing and row counters
+  ProcessProfiler profiler;
+
+  // dense copy of the MC particle truth, rebuilt once per dataframe
+  McTruthCache mcTruth;
+  std::vector<int32_t> v0Labels;
+  std::vector<int32_t> v0PdgCodes;
+
+  // mass histograms of processV0Candidate, per species, reconstructed and MC true
+  std::array<std::shared_ptr<TH1>, nV0Species> hMass;
+  std::array<std::shared_ptr<TH1>, nV0Species> hMassTrue;
+
+  // cut sets of the scan mode as one array per variable
+  std::vector<double> scanCosPA;
+  std::vector<float> scanDcaV0Dau;
+  std::vector<float> scanDcaNegToPV;
+  std::vector<float> scanDcaPosToPV;
+  std::vector<float> scanRadius;
+  std::vector<uint8_t> scanPass;
+  // mass vs cut set, per species, reconstructed and MC true
+  std::array<std::shared_ptr<TH2>, 3> hScanMass;
+  std::array<std::shared_ptr<TH2>, 3> hScanMassTrue;
+
+  void init(InitContext const&)
+  {
+    profiler.init(registry, {"processRun2", "processRun3", "processScanRun2", "processScanRun3"});
+    const bool run2 = doprocessRun2 || doprocessScanRun2;
+    const bool run3 = doprocessRun3 || doprocessScanRun3;
+    if (run2 && run3) {
+      LOGF(fatal, "Run 2 and Run 3 process functions share the collision Filter, enable only one of the two");
+    }
+    if ((run2 || run3) && (requireSel7 != run2 || requireSel8 != run3)) {
+      LOGF(fatal, "requireSel7 = %d and requireSel8 = %d do not match the Run %d process functions, set them to %d and %d", requireSel7.value, requireSel8.value, run2 ? 2 : 3, run2, run3);
+    }
+    if (doprocessSkipCounter) {
+      skipCounter.init(registry, "V0s");
+    }
+    hMass = {registry.get<TH1>(HIST("hMassK0Short")), registry.get<TH1>(HIST("hMassLambda")), registry.get<TH1>(HIST("hMassAntiLambda"))};
+    hMassTrue = {registry.get<TH1>(HIST("hMassTrueK0Short")), registry.get<TH1>(HIST("hMassTrueLambda")), registry.get<TH1>(HIST("hMassTrueAntiLambda"))};
+
+    if (doprocessScanRun2 || doprocessScanRun3) {
+      auto const& grid = cutScanGrid.value;
+      const int nSets = grid.rows();
+      for (int iSet = 0; iSet < nSets; ++iSet) {
+        scanCosPA.push_back(grid.get(iSet, 0u));
+        scanDcaV0Dau.push_back(grid.get(iSet, 1u));
+        scanDcaNegToPV.push_back(grid.get(iSet, 2u));
+        scanDcaPosToPV.push_back(grid.get(iSet, 3u));
+        scanRadius.push_back(grid.get(iSet, 4u));
+      }
+      scanPass.resize(nSets);
+
+      const AxisSpec axisCutSet{nSets, -0.5, nSets - 0.5, "cut set"};
+      const AxisSpec axisMassK0Short{200, 0.450f, 0.550f};
+      const AxisSpec axisMassLambda{200, 1.015f, 1.215f};
+      const std::array<std::string, 3> species{"K0Short", "Lambda", "AntiLambda"};
+      for (int iSpecies = 0; iSpecies < 3; ++iSpecies) {
+        auto const& axisMass = iSpecies == 0 ? axisMassK0Short : axisMassLambda;
+        hScanMass[iSpecies] = registry.add<TH2>(("scan/hMass" + species[iSpecies]).c_str(), ("hMass" + species[iSpecies]).c_str(), {HistType::kTH2F, {axisCutSet, axisMass}});
+        hScanMassTrue[iSpecies] = registry.add<TH2>(("scan/hMassTrue" + species[iSpecies]).c_str(), ("hMassTrue" + species[iSpecies]).c_str(), {HistType::kTH2F, {axisCutSet, axisMass}});
+        for (int iSet = 0; iSet < nSets; ++iSet) {
+          hScanMass[iSpecies]->GetXaxis()->SetBinLabel(iSet + 1, grid.getLabelsRows()[iSet].c_str());
+          hScanMassTrue[iSpecies]->GetXaxis()->SetBinLabel(iSet + 1, grid.getLabelsRows()[iSet].c_str());
+        }
+      }
+    }
+  }
+
+  // run() is called at the start of every dataframe
+  void run(ProcessingContext&)
+  {
+    mcTruth.invalidate();
+  }
+
+  void endOfStream(EndOfStreamContext&)
+  {
+    profiler.write();
+  }
+
+  //resolves the PDG codes of all V0s of a collision in one gather
+  template <typename TV0s>
+  void gatherV0PdgCodes(TV0s const& V0s, aod::McParticles const& mcParticles)
+  {
+    mcTruth.update(mcParticles);
+    v0Labels.clear();
+    for (auto& v0 : V0s) {
+      v0Labels.push_back(v0.mcParticleId());
+    }
+    v0PdgCodes.resize(v0Labels.size());
+    mcTruth.gatherPdgCode(v0Labels.data(), v0Labels.size(), v0PdgCodes.data());
+  }
+
   template <class TMyTracks, typename TV0>
-  void processV0Candidate(TV0 const& v0, float const& pvx, float const& pvy, float const& pvz)
+  void processV0Candidate(TV0 const& v0, int32_t pdgCode)
   //function to process a vzero candidate freely, actually with the right track type!
+  //all five topological selections are already applied by the filters
   {
     auto posTrackCast = v0.template posTrack_as<TMyTracks>();
     auto negTrackCast = v0.template negTrack_as<TMyTracks>();
     
-    float nsigma_pos_proton = TMath::Abs(posTrackCast.tpcNSigmaPr());
-    float nsigma_neg_proton = TMath::Abs(posTrackCast.tpcNSigmaPr());
-    float nsigma_pos_pion = TMath::Abs(negTrackCast.tpcNSigmaPi());
-    float nsigma_neg_pion = TMath::Abs(negTrackCast.tpcNSigmaPi());
-    
-    if (v0.v0radius() > v0radius && v0.v0cosPA(pvx, pvy, pvz) > v0cospa){
-      if( nsigma_pos_pion < 4 && nsigma_neg_pion < 4 ){
-        registry.fill(HIST("hMassK0Short"), v0.mK0Short());
-      }
-      if( nsigma_pos_proton < 4 && nsigma_neg_pion < 4 ){
-        registry.fill(HIST("hMassLambda"), v0.mLambda());
-      }
-      if( nsigma_pos_pion < 4 && nsigma_neg_proton < 4 ){
-        registry.fill(HIST("hMassAntiLambda"), v0.mAntiLambda());
-      }
-      
-      if( v0.has_mcParticle()){ //<- some association was made!
-        auto v0mcparticle = v0.mcParticle();
-        //check particle PDG code to see if it's the one you want
-        if ( v0mcparticle.pdgCode() == 310 ) registry.fill(HIST("hMassTrueK0Short"), v0.mK0Short());
-        if ( v0mcparticle.pdgCode() == 3122 ) registry.fill(HIST("hMassTrueLambda"), v0.mLambda());
-        if ( v0mcparticle.pdgCode() ==-3122 ) registry.fill(HIST("hMassTrueAntiLambda"), v0.mAntiLambda());
-      }
-      
-    }
+    //the proton n sigma of both hypotheses are read from the positive track, the pion ones from the negative track
+    auto pid = v0PidHypotheses(posTrackCast.tpcNSigmaPr(), posTrackCast.tpcNSigmaPr(), negTrackCast.tpcNSigmaPi(), negTrackCast.tpcNSigmaPi());
+
+    //check particle PDG code to see if it's the one you want (0 if no association was made)
+    fillV0Masses(pid, {v0.mK0Short(), v0.mLambda(), v0.mAntiLambda()}, v0TrueSpecies(pdgCode), hMass, hMassTrue);
   }
   
   //define first process function, used to process Run2 data
-  void processRun2(soa::Join<aod::Collisions, aod::EvSels>::iterator const& collision, soa::Filtered<LabeledV0s> const& V0s, MyTracksRun2 const& tracks, aod::McParticles const&)
+  void processRun2(SelectedCollisions::iterator const& collision, soa::Filtered<LabeledV0s> const& V0s, MyTracksRun2 const& tracks, aod::McParticles const& mcParticles)
   {
-    //Basic event selection (all helper tasks are now included!)
-    if (!collision.sel7()) {
-      return;
-    }
+    auto profile = profiler.measure(0, V0s.size());
+    //Basic event selection (all helper tasks are now included!) is done by collisionFilter
     //check getter here: https://aliceo2group.github.io/analysis-framework/docs/datamodel/ao2dTables.html
     registry.get<TH1>(HIST("hVertexZ"))->Fill(collision.posZ());
+    gatherV0PdgCodes(V0s, mcParticles);
+    int iV0 = 0;
     for (auto& v0 : V0s) {
-      processV0Candidate<MyTracksRun2>(v0, collision.posX(), collision.posY(), collision.posZ());
+      processV0Candidate<MyTracksRun2>(v0, v0PdgCodes[iV0++]);
     }
+    profile.addRowsOut(V0s.size());
   }
   PROCESS_SWITCH(vzeromcexample, processRun2, "Process Run 2 data", false);
 
   //define first process function, used to process Run3 data
-  void processRun3(soa::Join<aod::Collisions, aod::EvSels>::iterator const& collision, soa::Filtered<LabeledV0s> const& V0s, MyTracksRun3 const& tracks, aod::McParticles const&)
+  void processRun3(SelectedCollisions::iterator const& collision, soa::Filtered<LabeledV0s> const& V0s, MyTracksRun3 const& tracks, aod::McParticles const& mcParticles)
   {
-    //Basic event selection (all helper tasks are now included!)
-    if (!collision.sel8()) {
-      return;
-    }
+    auto profile = profiler.measure(1, V0s.size());
+    //Basic event selection (all helper tasks are now included!) is done by collisionFilter
     //check getter here: https://aliceo2group.github.io/analysis-framework/docs/datamodel/ao2dTables.html
     registry.get<TH1>(HIST("hVertexZ"))->Fill(collision.posZ());
+    gatherV0PdgCodes(V0s, mcParticles);
+    int iV0 = 0;
     for (auto& v0 : V0s) {
-      processV0Candidate<MyTracksRun3>(v0, collision.posX(), collision.posY(), collision.posZ());
+      processV0Candidate<MyTracksRun3>(v0, v0PdgCodes[iV0++]);
     }
+    profile.addRowsOut(V0s.size());
   }
   PROCESS_SWITCH(vzeromcexample, processRun3, "Process Run 3 data", true);
+
+  //scan mode: all V0s of the collision against all cut sets, returns the
+  //number of V0s passing at least one of them
+  template <class TMyTracks, typename TV0s>
+  uint64_t scanV0Candidates(TV0s const& V0s)
+  {
+    const std::size_t nSets = scanPass.size();
+    uint64_t nPassing = 0;
+    for (auto& v0 : V0s) {
+      const double cosPA = v0.cosPA();
+      const float dcaV0Dau = v0.dcaV0daughters();
+      const float dcaNegToPV = std::abs(v0.dcanegtopv());
+      const float dcaPosToPV = std::abs(v0.dcapostopv());
+      const float radius = v0.radius();
+      uint8_t anyPass = 0;
+      for (std::size_t iSet = 0; iSet < nSets; ++iSet) {
+        scanPass[iSet] = (cosPA > scanCosPA[iSet]) & (dcaV0Dau < scanDcaV0Dau[iSet]) & (dcaNegToPV > scanDcaNegToPV[iSet]) & (dcaPosToPV > scanDcaPosToPV[iSet]) & (radius > scanRadius[iSet]);
+        anyPass |= scanPass[iSet];
+      }
+      if (!anyPass) {
+        continue; //no daughter lookup for V0s failing every cut set
+      }
+      nPassing++;
+
+      auto posTrackCast = v0.template posTrack_as<TMyTracks>();
+      auto negTrackCast = v0.template negTrack_as<TMyTracks>();
+      const auto pid = v0PidHypotheses(posTrackCast.tpcNSigmaPr(), posTrackCast.tpcNSigmaPr(), negTrackCast.tpcNSigmaPi(), negTrackCast.tpcNSigmaPi());
+      const std::array<float, 3> mass{v0.mK0Short(), v0.mLambda(), v0.mAntiLambda()};
+      int trueSpecies = -1;
+      if (v0.has_mcParticle()) {
+        trueSpecies = v0TrueSpecies(mcTruth.pdgCode(v0.mcParticleId()));
+      }
+
+      for (std::size_t iSet = 0; iSet < nSets; ++iSet) {
+        if (!scanPass[iSet]) {
+          continue;
+        }
+        for (int iSpecies = 0; iSpecies < nV0Species; ++iSpecies) {
+          if (pid[iSpecies]) {
+            hScanMass[iSpecies]->Fill(iSet, mass[iSpecies]);
+          }
+        }
+        if (trueSpecies >= 0) {
+          hScanMassTrue[trueSpecies]->Fill(iSet, mass[trueSpecies]);
+        }
+      }
+    }
+    return nPassing;
+  }
+
+  void processScanRun2(SelectedCollisions::iterator const& collision, LabeledV0s const& V0s, MyTracksRun2 const& tracks, aod::McParticles const& mcParticles)
+  {
+    auto profile = profiler.measure(2, V0s.size());
+    mcTruth.update(mcParticles);
+    profile.addRowsOut(scanV0Candidates<MyTracksRun2>(V0s));
+  }
+  PROCESS_SWITCH(vzeromcexample, processScanRun2, "Cut scan on Run 2 data", false);
+
+  void processScanRun3(SelectedCollisions::iterator const& collision, LabeledV0s const& V0s, MyTracksRun3 const& tracks, aod::McParticles const& mcParticles)
+  {
+    auto profile = profiler.measure(3, V0s.size());
+    mcTruth.update(mcParticles);
+    profile.addRowsOut(scanV0Candidates<MyTracksRun3>(V0s));
+  }
+  PROCESS_SWITCH(vzeromcexample, processScanRun3, "Cut scan on Run 3 data", false);
+
+  //once per dataframe: collisions rejected by collisionFilter and their V0s
+  void processSkipCounter(SelectedCollisions const& collisions, aod::V0Datas const& V0s)
+  {
+    skipCounter.count(collisions, V0s);
+  }
+  PROCESS_SWITCH(vzeromcexample, processSkipCounter, "Count the collisions and V0s skipped by the event selection", true);
   
 };
 
 WorkflowSpec defineDataProcessing(ConfigContext const& cfgc)
 {
   return WorkflowSpec{
+    adaptAnalysisTask<v0topologybuilder>(cfgc),
     adaptAnalysisTask<vzeromcexample>(cfgc)
   };
 }
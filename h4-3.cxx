@@ -16,60 +16,138 @@
 /// \author
 /// \since
 
+#include <algorithm>
+#include <array>
+#include <vector>
+
 #include "Framework/runDataProcessing.h"
 #include "Framework/AnalysisTask.h"
 #include "Framework/HistogramRegistry.h"
 #include "PWGHF/DataModel/CandidateReconstructionTables.h"
 #include "PWGHF/DataModel/CandidateSelectionTables.h"
-#include <iostream>
+#include "ColumnCodec.h"
+#include "D0CandidateKernel.h"
+#include "DerivedTables.h"
+#include "ReadDerivedTable.h"
 
 using namespace o2;
 using namespace o2::framework;
 using namespace o2::framework::expressions;
+using namespace o2::analysis::hadrex;
 
 // STEP 3
-//<- starting point, define the derived table to be stored
-// this can be done in a separated header file, but for semplicity we do it in
-// the same file here
+//<- starting point, the derived table to be stored is defined in DerivedTables.h
+// and the task reading it back in ReadDerivedTable.h
 
-namespace o2::aod
-{
-namespace mytable
+// Default 16-bit encoding of the MyTableCompact columns, one row per column
+namespace mytable_codec
 {
-DECLARE_SOA_COLUMN(InvMassD0, invMassD0, float);           //!
-DECLARE_SOA_COLUMN(InvMassD0bar, invMassD0bar, float);     //!
-DECLARE_SOA_COLUMN(Pt, pt, float);                         //!
-DECLARE_SOA_COLUMN(CosinePointing, cosinePointing, float); //!
-DECLARE_SOA_INDEX_COLUMN(Collision, collision);            //!
-} // namespace mytable
-
-DECLARE_SOA_TABLE(MyTable, "AOD", "MYTABLE", //!
-                  mytable::InvMassD0,
-                  mytable::InvMassD0bar,
-                  mytable::Pt,
-                  mytable::CosinePointing,
-                  mytable::CollisionId)
-
-} // namespace o2::aod
+static constexpr int nColumns = 4;
+static constexpr int nCodecPars = 4;
+static constexpr float defaultCodecs[nColumns][nCodecPars] = {{1.f, 1.75f, 2.05f, 0.f},  // fixed point, 4.6 keV steps
+                                                              {1.f, 1.75f, 2.05f, 0.f},  // fixed point
+                                                              {2.f, 0.f, 0.f, 0.f},      // float16
+                                                              {1.f, -1.f, 1.f, 0.f}};    // fixed point
+static const std::vector<std::string> labelsColumns{"invMassD0", "invMassD0bar", "pt", "cosinePointing"};
+static const std::vector<std::string> labelsCodecPars{"encoding", "min", "max", "resolution"};
+} // namespace mytable_codec
 
 struct ProduceDerivedTable { //<- workflow that loops over HF 2-prong
                              // candidates and fills a derived table
 
   Produces<aod::MyTable> tableWithDzeroCandidates;
+  Produces<aod::MyTableCompact> compactTableWithDzeroCandidates;
+  Produces<aod::MyTableCodecs> compactTableCodecs;
+  Produces<aod::MyZoneMaps> zoneMaps;
+  Produces<aod::MyCollisionSlices> collisionSlices;
+
+  // 16-bit output: encoding 1 is fixed point over [min, max] in steps of resolution
+  // (0: finest possible), encoding 2 is float16 (min, max, resolution unused)
+  Configurable<bool> compactEncoding{"compactEncoding", false, "Write MyTableCompact and MyTableCodecs instead of MyTable"};
+  Configurable<LabeledArray<float>> columnCodecs{"columnCodecs", {mytable_codec::defaultCodecs[0], mytable_codec::nColumns, mytable_codec::nCodecPars, mytable_codec::labelsColumns, mytable_codec::labelsCodecPars}, "Encoding, min, max and resolution of the MyTableCompact columns"};
+
+  std::array<ColumnCodec, mytable_codec::nColumns> codecs;
+  std::array<float, mytable_codec::nColumns> maxErrorDataframe{};
+  std::array<float, mytable_codec::nColumns> maxError{};
+
+  // per-process timing and row counters (rows out are the D0 rows written)
+  HistogramRegistry registry{"registry", {}};
+  ProcessProfiler profiler;
+
+  void init(InitContext const&)
+  {
+    profiler.init(registry, {"process"});
+
+    if (compactEncoding) {
+      auto const& pars = columnCodecs.value;
+      auto hError = registry.add<TH1>("hRoundTripError", "max round-trip error;;|decoded - value|", {HistType::kTH1D, {{mytable_codec::nColumns, -0.5, mytable_codec::nColumns - 0.5}}});
+      for (int iColumn = 0; iColumn < mytable_codec::nColumns; ++iColumn) {
+        const float encoding = pars.get(iColumn, 0u);
+        if (encoding != static_cast<int>(ColumnEncoding::kFixedPoint16) && encoding != static_cast<int>(ColumnEncoding::kFloat16)) {
+          LOGF(fatal, "Column %s: encoding %f is neither 1 (fixed point) nor 2 (float16)", mytable_codec::labelsColumns[iColumn], encoding);
+        }
+        codecs[iColumn] = {static_cast<ColumnEncoding>(static_cast<int>(encoding)), pars.get(iColumn, 1u), pars.get(iColumn, 2u), pars.get(iColumn, 3u)};
+        if (!codecs[iColumn].isValid()) {
+          LOGF(fatal, "Column %s: range [%f, %f] does not fit in 16 bits with resolution %f", mytable_codec::labelsColumns[iColumn], codecs[iColumn].min, codecs[iColumn].max, codecs[iColumn].resolution);
+        }
+        hError->GetXaxis()->SetBinLabel(iColumn + 1, mytable_codec::labelsColumns[iColumn].c_str());
+      }
+    }
+  }
 
-  void process(aod::HfCand2Prong const& cand2Prongs, aod::Tracks const&)
+  void endOfStream(EndOfStreamContext&)
   {
+    if (compactEncoding) {
+      auto hError = registry.get<TH1>(HIST("hRoundTripError"));
+      for (int iColumn = 0; iColumn < mytable_codec::nColumns; ++iColumn) {
+        hError->SetBinContent(iColumn + 1, maxError[iColumn]);
+      }
+    }
+    profiler.write();
+  }
+
+  // writes one compact row and keeps track of the round-trip error
+  void fillCompact(std::array<float, mytable_codec::nColumns> const& values, int collisionId)
+  {
+    std::array<uint16_t, mytable_codec::nColumns> codes;
+    for (int iColumn = 0; iColumn < mytable_codec::nColumns; ++iColumn) {
+      codes[iColumn] = codecs[iColumn].encode(values[iColumn]);
+      maxErrorDataframe[iColumn] = std::max(maxErrorDataframe[iColumn], codecs[iColumn].roundTripError(values[iColumn]));
+    }
+    compactTableWithDzeroCandidates(codes[0], codes[1], codes[2], codes[3], collisionId);
+  }
+
+  // the values as ReadDerivedTable decodes them from the compact table; the
+  // zone maps of a compact skim hold their min/max, so that the windows
+  // prune on the same values as they select
+  std::array<float, mytable_codec::nColumns> decodedValues(std::array<float, mytable_codec::nColumns> const& values) const
+  {
+    std::array<float, mytable_codec::nColumns> decoded;
+    for (int iColumn = 0; iColumn < mytable_codec::nColumns; ++iColumn) {
+      decoded[iColumn] = codecs[iColumn].decode(codecs[iColumn].encode(values[iColumn]));
+    }
+    return decoded;
+  }
+
+  // selected candidates of the current dataframe, written out ordered by
+  // collision, and the min/max of their columns, same order as the codecs
+  D0CandidateKernel selected;
+  static_assert(D0CandidateKernel::nColumns == mytable_codec::nColumns);
+
+  void process(aod::HfCand2Prong const& cand2Prongs)
+  {
+    auto profile = profiler.measure(0, cand2Prongs.size());
+    maxErrorDataframe.fill(0.f);
+    selected.clear();
 
     // loop over 2-prong candidates
     for (auto& cand : cand2Prongs) {
 
-      std::cout << "chama!" << std::endl;
-
       // check first if the HF 2-prong candidate is tagged as a D0
       bool isD0Sel = TESTBIT(cand.hfflag(), aod::hf_cand_2prong::DecayType::D0ToPiK);
 
       // let's select only D0 andidates with pT > 4 GeV/c
-      if (!isD0Sel || cand.pt() < 4.) {
+      if (!isSelectedD0(isD0Sel, cand.pt())) {
         continue;
       }
 
@@ -81,32 +159,37 @@ struct ProduceDerivedTable { //<- workflow that loops over HF 2-prong
                  << ", pt = " << cand.pt()
                  << ", cos(theta_P) = " << cand.cpa();
 
-      // we retrieve also the event index from one of the daughters
-      auto dauTrack = cand.prong0_as<aod::Tracks>(); // positive daughter
-
-      tableWithDzeroCandidates(invMassD0, invMassD0bar, cand.pt(), cand.cpa(), dauTrack.collisionId());
+      // the event index is the one of the candidate (the collision used for the
+      // secondary vertex), so the daughter tracks are not needed
+      // the masses are computed in double precision, the tables store floats
+      selected.add(cand.collisionId(), {static_cast<float>(invMassD0), static_cast<float>(invMassD0bar), cand.pt(), cand.cpa()});
     }
-  }
-};
-
-struct ReadDerivedTable { //<- workflow that reads derived table and fill
-                          // histograms
-
-  HistogramRegistry registry{"registry",
-                             {{"hMassD0", ";#it{M}(K#pi) (GeV/#it{c}^{2});counts", {HistType::kTH1F, {{300, 1.75, 2.05}}}},
-                              {"hMassD0bar", ";#it{M}(#piK) (GeV/#it{c}^{2});counts", {HistType::kTH1F, {{300, 1.75, 2.05}}}},
-                              {"hPt", ";#it{p}_{T} (GeV/#it{c});counts", {HistType::kTH1F, {{50, 0., 50.}}}},
-                              {"hCosp", ";cos(#vartheta_{P}) ;counts", {HistType::kTH1F, {{100, 0.8, 1.}}}}}};
-
-  void process(aod::MyTable const& cand2Prongs)
-  {
 
-    // loop over 2-prong candidates
-    for (auto& cand : cand2Prongs) {
-      registry.fill(HIST("hMassD0"), cand.invMassD0());
-      registry.fill(HIST("hMassD0bar"), cand.invMassD0bar());
-      registry.fill(HIST("hPt"), cand.pt());
-      registry.fill(HIST("hCosp"), cand.cosinePointing());
+    // one slice per collision, the candidates of one collision keep their input order
+    int nRows = selected.write(
+      [&](int collisionId, int offset, int nCandidates) { collisionSlices(collisionId, offset, nCandidates); },
+      [&](auto const& values, int collisionId) {
+        if (compactEncoding) {
+          fillCompact(values, collisionId);
+        } else {
+          tableWithDzeroCandidates(values[0], values[1], values[2], values[3], collisionId);
+        }
+      },
+      [&](auto const& values) { return compactEncoding ? decodedValues(values) : values; });
+    profile.addRowsOut(nRows);
+
+    // one zone map row per dataframe, empty ones included
+    auto const& zoneMin = selected.zoneMin();
+    auto const& zoneMax = selected.zoneMax();
+    zoneMaps(nRows, zoneMin[0], zoneMax[0], zoneMin[1], zoneMax[1], zoneMin[2], zoneMax[2], zoneMin[3], zoneMax[3]);
+
+    // the codecs go with every dataframe, so that each one can be decoded alone
+    if (compactEncoding) {
+      for (int iColumn = 0; iColumn < mytable_codec::nColumns; ++iColumn) {
+        auto const& codec = codecs[iColumn];
+        compactTableCodecs(static_cast<int8_t>(codec.encoding), codec.min, codec.max, codec.resolution, maxErrorDataframe[iColumn]);
+        maxError[iColumn] = std::max(maxError[iColumn], maxErrorDataframe[iColumn]);
+      }
     }
   }
 };
@@ -0,0 +1,111 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \brief Reads the derived tables from the derived AO2D (see h4-final) and
+///        writes them as Arrow IPC files, <outputPrefix><TABLE>.arrow, one
+///        record batch per dataframe. The uncompressed files are read in
+///        place by o2-analysistutorial-read-derived-arrow, without DPL.
+/// \author
+/// \since
+
+#include <array>
+#include <string>
+
+#include "Framework/runDataProcessing.h"
+#include "Framework/AnalysisTask.h"
+#include "Framework/HistogramRegistry.h"
+#include "ArrowTableExporter.h"
+#include "DerivedTables.h"
+#include "ProcessProfiler.h"
+
+using namespace o2;
+using namespace o2::framework;
+using namespace o2::analysis::hadrex;
+
+// STEP 5
+// The derived table is exported once; re-binning or changing the windows
+// then only needs the standalone reader
+
+struct ExportDerivedTables {
+  Configurable<std::string> outputPrefix{"outputPrefix", "derived-", "Prefix of the Arrow IPC files, <outputPrefix><TABLE>.arrow"};
+  Configurable<bool> lz4{"lz4", false, "LZ4-compress the record batches (smaller files, but the reader decompresses instead of mapping)"};
+
+  HistogramRegistry registry{"registry", {}};
+
+  // per-process timing and row counters
+  ProcessProfiler profiler;
+
+  static constexpr int nTables = 5;
+  static constexpr std::array<const char*, nTables> tableNames = {"MYTABLE", "MYTABLECOMPACT", "MYTABLECODEC", "MYZONEMAP", "MYCOLLSLICE"};
+  std::array<ArrowTableExporter, nTables> exporters;
+
+  void init(InitContext const&)
+  {
+    profiler.init(registry, {"processMyTable", "processMyTableCompact", "processMyTableCodecs", "processMyZoneMaps", "processMyCollisionSlices"});
+    const std::array<bool, nTables> enabled = {doprocessMyTable, doprocessMyTableCompact, doprocessMyTableCodecs, doprocessMyZoneMaps, doprocessMyCollisionSlices};
+    for (int iTable = 0; iTable < nTables; ++iTable) {
+      if (enabled[iTable]) {
+        exporters[iTable].open(outputPrefix.value + tableNames[iTable] + ".arrow", lz4);
+      }
+    }
+  }
+
+  void endOfStream(EndOfStreamContext&)
+  {
+    for (auto& exporter : exporters) {
+      exporter.close();
+    }
+    profiler.write();
+  }
+
+  template <int iTable, typename TTable>
+  void exportTable(TTable const& table)
+  {
+    auto profile = profiler.measure(iTable, table.size());
+    exporters[iTable].write(*table.asArrowTable());
+    profile.addRowsOut(table.size());
+  }
+
+  void processMyTable(aod::MyTable const& table)
+  {
+    exportTable<0>(table);
+  }
+  PROCESS_SWITCH(ExportDerivedTables, processMyTable, "Export MyTable", true);
+
+  void processMyTableCompact(aod::MyTableCompact const& table)
+  {
+    exportTable<1>(table);
+  }
+  PROCESS_SWITCH(ExportDerivedTables, processMyTableCompact, "Export MyTableCompact", false);
+
+  void processMyTableCodecs(aod::MyTableCodecs const& table)
+  {
+    exportTable<2>(table);
+  }
+  PROCESS_SWITCH(ExportDerivedTables, processMyTableCodecs, "Export MyTableCodecs", false);
+
+  void processMyZoneMaps(aod::MyZoneMaps const& table)
+  {
+    exportTable<3>(table);
+  }
+  PROCESS_SWITCH(ExportDerivedTables, processMyZoneMaps, "Export MyZoneMaps", false);
+
+  void processMyCollisionSlices(aod::MyCollisionSlices const& table)
+  {
+    exportTable<4>(table);
+  }
+  PROCESS_SWITCH(ExportDerivedTables, processMyCollisionSlices, "Export MyCollisionSlices", false);
+};
+
+WorkflowSpec defineDataProcessing(ConfigContext const& cfgc)
+{
+  return WorkflowSpec{adaptAnalysisTask<ExportDerivedTables>(cfgc)};
+}
@@ -0,0 +1,256 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file read-derived-arrow.cxx
+/// \brief Fills the ReadDerivedTable histograms (hMassD0, hMassD0bar, hPt,
+///        hCosp) from MyTable exported by h4-export, without DPL. The Arrow
+///        IPC files are memory-mapped and the float columns of uncompressed
+///        record batches are binned where they lie in the mapping; the
+///        columns of LZ4-compressed batches are decompressed first. The
+///        windows are those of ReadDerivedTable, plus an optional lower cut
+///        on cos(theta_P) and a configurable number of mass bins.
+///
+///        The histograms are written to the directory read-derived-table of
+///        the output file, as in AnalysisResults.root.
+/// \author
+/// \since
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arrow/array.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/reader.h>
+#include <arrow/record_batch.h>
+
+#include <boost/program_options.hpp>
+
+#include "TFile.h"
+#include "TH1F.h"
+
+#include "FillBuffer.h"
+
+using namespace o2::analysis::hadrex;
+
+namespace
+{
+
+struct Windows {
+  bool select = false;
+  float ptMin = 0.f;
+  float ptMax = 50.f;
+  float massMin = 1.75f;
+  float massMax = 2.05f;
+  float cospMin = -1.f;
+
+  bool pass(float invMassD0, float invMassD0bar, float pt, float cosp) const
+  {
+    bool massInWindow = (invMassD0 >= massMin && invMassD0 < massMax) || (invMassD0bar >= massMin && invMassD0bar < massMax);
+    return (!select || (pt >= ptMin && pt < ptMax && massInWindow)) && cosp >= cospMin;
+  }
+};
+
+constexpr int nColumns = 4;
+constexpr std::array<const char*, nColumns> columnNames = {"fInvMassD0", "fInvMassD0bar", "fPt", "fCosinePointing"};
+
+struct Statistics {
+  int64_t batches = 0;
+  int64_t rows = 0;
+  int64_t rowsFilled = 0;
+  int64_t bytesMapped = 0;
+  int64_t columnsInPlace = 0;
+  int64_t columnsCopied = 0;
+};
+
+class Reader
+{
+ public:
+  Reader(std::array<TH1*, nColumns> const& histograms, Windows const& windows) : mHistograms(histograms), mWindows(windows)
+  {
+    for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+      mBinnings[iColumn] = UniformBinning(histograms[iColumn]->GetXaxis());
+      mCounts[iColumn].setSize(mBinnings[iColumn].nBins + 2);
+    }
+  }
+
+  /// Returns false with a message on stderr if the file cannot be read
+  bool read(std::string const& path, Statistics& statistics)
+  {
+    auto file = arrow::io::MemoryMappedFile::Open(path, arrow::io::FileMode::READ);
+    if (!file.ok()) {
+      std::cerr << "Cannot map " << path << ": " << file.status().ToString() << "\n";
+      return false;
+    }
+    // the whole mapping, to tell the columns read in place from the decompressed ones
+    auto size = (*file)->GetSize();
+    auto mapping = (*file)->ReadAt(0, size.ok() ? *size : 0);
+    auto reader = arrow::ipc::RecordBatchFileReader::Open(*file);
+    if (!size.ok() || !mapping.ok() || !reader.ok()) {
+      std::cerr << "Cannot read " << path << ": " << (!size.ok() ? size.status() : !mapping.ok() ? mapping.status() : reader.status()).ToString() << "\n";
+      return false;
+    }
+    const uint8_t* begin = (*mapping)->data();
+    const uint8_t* end = begin + (*mapping)->size();
+    statistics.bytesMapped += (*mapping)->size();
+
+    for (int iBatch = 0; iBatch < (*reader)->num_record_batches(); ++iBatch) {
+      auto batch = (*reader)->ReadRecordBatch(iBatch);
+      if (!batch.ok()) {
+        std::cerr << path << ", record batch " << iBatch << ": " << batch.status().ToString() << "\n";
+        return false;
+      }
+      std::array<const float*, nColumns> values;
+      for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+        auto column = (*batch)->GetColumnByName(columnNames[iColumn]);
+        if (!column || column->type_id() != arrow::Type::FLOAT || column->null_count() != 0) {
+          std::cerr << path << ": no float column " << columnNames[iColumn] << " without nulls, not a MyTable export\n";
+          return false;
+        }
+        values[iColumn] = std::static_pointer_cast<arrow::FloatArray>(column)->raw_values();
+        const auto* data = reinterpret_cast<const uint8_t*>(values[iColumn]);
+        if (data >= begin && data < end) {
+          statistics.columnsInPlace++;
+        } else {
+          statistics.columnsCopied++;
+        }
+      }
+      const int64_t nRows = (*batch)->num_rows();
+      statistics.batches++;
+      statistics.rows += nRows;
+      statistics.rowsFilled += fill(values, nRows);
+    }
+    return true;
+  }
+
+  /// Adds the counts to the histograms
+  void flush()
+  {
+    for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+      mCounts[iColumn].mergeInto(mHistograms[iColumn]);
+    }
+  }
+
+ private:
+  // bins the rows passing the windows, the selected rows are compacted first
+  std::size_t fill(std::array<const float*, nColumns> values, std::size_t n)
+  {
+    if (mWindows.select || mWindows.cospMin > -1.f) {
+      for (auto& selected : mSelected) {
+        selected.clear();
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        if (mWindows.pass(values[0][i], values[1][i], values[2][i], values[3][i])) {
+          for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+            mSelected[iColumn].push_back(values[iColumn][i]);
+          }
+        }
+      }
+      n = mSelected[0].size();
+      for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+        values[iColumn] = mSelected[iColumn].data();
+      }
+    }
+    mBins.resize(n);
+    for (int iColumn = 0; iColumn < nColumns; ++iColumn) {
+      mBinnings[iColumn].findBins(values[iColumn], n, mBins.data());
+      mCounts[iColumn].add(mBins.data(), n);
+    }
+    return n;
+  }
+
+  std::array<TH1*, nColumns> mHistograms;
+  Windows mWindows;
+  std::array<UniformBinning, nColumns> mBinnings;
+  std::array<BinnedCounts, nColumns> mCounts;
+  std::array<std::vector<float>, nColumns> mSelected;
+  std::vector<int> mBins;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  namespace po = boost::program_options;
+  Windows windows;
+  std::vector<std::string> inputs;
+  std::string output;
+  int nBinsMass = 300;
+  po::options_description description("Fills the ReadDerivedTable histograms from memory-mapped MyTable Arrow IPC files");
+  description.add_options()("help,h", "print this help")                                                                      //
+    ("input,i", po::value(&inputs)->multitoken(), "MyTable Arrow IPC files written by h4-export")                            //
+    ("output,o", po::value(&output)->default_value("read-derived-arrow.root"), "output ROOT file")                          //
+    ("mass-bins", po::value(&nBinsMass)->default_value(nBinsMass), "number of bins of hMassD0 and hMassD0bar in [1.75, 2.05)") //
+    ("select-windows", po::bool_switch(&windows.select), "apply the pt and mass windows")                                   //
+    ("pt-min", po::value(&windows.ptMin)->default_value(windows.ptMin), "lower edge of the pt window")                      //
+    ("pt-max", po::value(&windows.ptMax)->default_value(windows.ptMax), "upper edge of the pt window")                      //
+    ("mass-min", po::value(&windows.massMin)->default_value(windows.massMin), "lower edge of the invariant mass window")    //
+    ("mass-max", po::value(&windows.massMax)->default_value(windows.massMax), "upper edge of the invariant mass window")    //
+    ("cosp-min", po::value(&windows.cospMin)->default_value(windows.cospMin), "lower cut on cos(theta_P), -1: no cut");
+  po::positional_options_description positional;
+  positional.add("input", -1);
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(description).positional(positional).run(), vm);
+    po::notify(vm);
+  } catch (po::error const& e) {
+    std::cerr << e.what() << "\n"
+              << description << "\n";
+    return 1;
+  }
+  if (vm.count("help")) {
+    std::cout << description << "\n";
+    return 0;
+  }
+  if (inputs.empty() || nBinsMass <= 0) {
+    std::cerr << "at least one input file is needed and mass-bins must be positive\n";
+    return 1;
+  }
+
+  // same binning as ReadDerivedTable, apart from the number of mass bins
+  TH1::AddDirectory(false);
+  TH1F hMassD0("hMassD0", ";#it{M}(K#pi) (GeV/#it{c}^{2});counts", nBinsMass, 1.75, 2.05);
+  TH1F hMassD0bar("hMassD0bar", ";#it{M}(#piK) (GeV/#it{c}^{2});counts", nBinsMass, 1.75, 2.05);
+  TH1F hPt("hPt", ";#it{p}_{T} (GeV/#it{c});counts", 50, 0., 50.);
+  TH1F hCosp("hCosp", ";cos(#vartheta_{P}) ;counts", 100, 0.8, 1.);
+
+  Reader reader({&hMassD0, &hMassD0bar, &hPt, &hCosp}, windows);
+  Statistics statistics;
+  auto start = std::chrono::steady_clock::now();
+  for (auto const& input : inputs) {
+    if (!reader.read(input, statistics)) {
+      return 1;
+    }
+  }
+  reader.flush();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  TFile file(output.c_str(), "RECREATE");
+  if (file.IsZombie()) {
+    std::cerr << "Cannot create " << output << "\n";
+    return 1;
+  }
+  auto* directory = file.mkdir("read-derived-table");
+  for (TH1* histogram : std::initializer_list<TH1*>{&hMassD0, &hMassD0bar, &hPt, &hCosp}) {
+    directory->WriteTObject(histogram);
+  }
+  file.Close();
+
+  std::cout << statistics.rows << " rows in " << statistics.batches << " record batches, " << statistics.rowsFilled << " filled\n"
+            << statistics.bytesMapped << " bytes mapped, " << statistics.columnsInPlace << " columns read in place, "
+            << statistics.columnsCopied << " decompressed\n"
+            << elapsed.count() << " s, " << (elapsed.count() > 0. ? statistics.rows / elapsed.count() : 0.) << " rows/s\n";
+  return 0;
+}
@@ -1,4 +1,4 @@
-export OPT="-b --configuration json://dpl-config-h3-final.json"
+export OPT="-b --configuration json://${HADREX_DPL_CONFIG:-dpl-config-h3-final.json} --resources-monitoring 2 ${HADREX_EXTRA_OPT}"
 o2-analysistutorial-h3-final ${OPT} | \
 o2-analysis-timestamp ${OPT} | \
 o2-analysis-track-propagation ${OPT} | \
@@ -2,7 +2,7 @@
 #For the simple reading, it should suffice to do:
 #o2-analysistutorial-h4-4-skimming --aod-file AO2D.root
 #...with the resulting file!
-export OPT="-b --configuration json://dpl-config.json --resources-monitoring 2 --aod-memory-rate-limit 1000000000 --shm-segment-size 7500000000"
+export OPT="-b --configuration json://${HADREX_DPL_CONFIG:-dpl-config.json} --resources-monitoring 2 --aod-memory-rate-limit 1000000000 --shm-segment-size 7500000000 ${HADREX_EXTRA_OPT}"
 o2-analysis-timestamp ${OPT} | \
 o2-analysis-event-selection ${OPT} | \
 #o2-analysis-multiplicity-table ${OPT} | \
@@ -0,0 +1,6 @@
+#This is the export of the derived tables to Arrow IPC files.
+#It reads the AO2D_derived.root written by run-h4-3.sh (ProduceDerivedTable); the files are
+#then read without DPL, e.g.
+#o2-analysistutorial-read-derived-arrow derived-MYTABLE.arrow
+export OPT="-b --configuration json://${HADREX_DPL_CONFIG:-dpl-config-h4-export.json} --resources-monitoring 2 ${HADREX_EXTRA_OPT}"
+o2-analysistutorial-h4-export ${OPT}
@@ -0,0 +1,1018 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+///
+/// \file synthetic-ao2d.cxx
+/// \brief Writes a synthetic MC AO2D file for scaling studies of the h1-h4
+///        workflows: collisions with a configurable multiplicity
+///        distribution, primary pions, kaons and protons, and injected
+///        K0S, Lambda and D0 decays with their daughter tracks, V0 and
+///        2-prong candidates and MC labels.
+///
+///        The tree and branch names are not hard-coded in the generator:
+///        they are read from a schema (built-in, see defaultSchema, or
+///        --schema file), so that they can follow the data model version
+///        of the O2Physics release. Branches of the schema that the
+///        generator does not know are written as zero, values the
+///        generator computes for branches absent from the schema are
+///        dropped.
+///
+///        Tracks are straight lines from their production vertex
+///        (no magnetic field), which is enough for throughput studies.
+///        Every collision has its own BC with TVX-triggered FT0, FV0A and
+///        FDD rows, so that it passes sel8. The run number (--run-number)
+///        must be known to the CCDB for the timestamp task; the chains and
+///        the configuration changes they need are run by
+///        Tools/run-synthetic.py.
+/// \author
+/// \since
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "TFile.h"
+#include "TLorentzVector.h"
+#include "TMap.h"
+#include "TObjString.h"
+#include "TTree.h"
+#include "TVector3.h"
+
+namespace
+{
+
+// One table per "table <tree name>" line, followed by its branches as
+// "<branch name> <type>". Types are ROOT leaf codes (B int8, b uint8,
+// S int16, s uint16, I int32, i uint32, l uint64, F float), with [n]
+// appended for a fixed-size array (e.g. S[8]) and [] for a variable-size
+// array with a <name>_size counter branch (e.g. F[]).
+const char* defaultSchema = R"(
+table O2bc
+fRunNumber I
+fGlobalBC l
+fTriggerMask l
+
+table O2collision
+fIndexBCs I
+fPosX F
+fPosY F
+fPosZ F
+fCovXX F
+fCovXY F
+fCovYY F
+fCovXZ F
+fCovYZ F
+fCovZZ F
+fFlags s
+fChi2 F
+fNumContrib s
+fCollisionTime F
+fCollisionTimeRes F
+fCollisionTimeMask b
+
+table O2mccollision
+fIndexBCs I
+fGeneratorsID S
+fPosX F
+fPosY F
+fPosZ F
+fT F
+fWeight F
+fImpactParameter F
+
+table O2mccollisionlabel
+fIndexMcCollisions I
+fMcMask s
+
+table O2track_iu
+fIndexCollisions I
+fTrackType b
+fX F
+fAlpha F
+fY F
+fZ F
+fSnp F
+fTgl F
+fSigned1Pt F
+
+table O2trackcov_iu
+fSigmaY F
+fSigmaZ F
+fSigmaSnp F
+fSigmaTgl F
+fSigma1Pt F
+fRhoZY B
+fRhoSnpY B
+fRhoSnpZ B
+fRhoTglY B
+fRhoTglZ B
+fRhoTglSnp B
+fRho1PtY B
+fRho1PtZ B
+fRho1PtSnp B
+fRho1PtTgl B
+
+table O2track
+fIndexCollisions I
+fTrackType b
+fX F
+fAlpha F
+fY F
+fZ F
+fSnp F
+fTgl F
+fSigned1Pt F
+
+table O2trackcov
+fSigmaY F
+fSigmaZ F
+fSigmaSnp F
+fSigmaTgl F
+fSigma1Pt F
+fRhoZY B
+fRhoSnpY B
+fRhoSnpZ B
+fRhoTglY B
+fRhoTglZ B
+fRhoTglSnp B
+fRho1PtY B
+fRho1PtZ B
+fRho1PtSnp B
+fRho1PtTgl B
+
+table O2trackdca
+fDcaXY F
+fDcaZ F
+
+table O2trackextra
+fTPCInnerParam F
+fFlags i
+fITSClusterMap b
+fTPCNClsFindable b
+fTPCNClsFindableMinusFound B
+fTPCNClsFindableMinusCrossedRows B
+fTPCNClsShared b
+fTRDPattern b
+fITSChi2NCl F
+fTPCChi2NCl F
+fTRDChi2 F
+fTOFChi2 F
+fTPCSignal F
+fTRDSignal F
+fLength F
+fTOFExpMom F
+fTrackEtaEMCAL F
+fTrackPhiEMCAL F
+fTrackTime F
+fTrackTimeRes F
+
+table O2mcparticle_001
+fIndexMcCollisions I
+fPdgCode I
+fStatusCode I
+fFlags b
+fIndexArray_Mothers I[]
+fIndexSlice_Daughters I[2]
+fWeight F
+fPx F
+fPy F
+fPz F
+fE F
+fVx F
+fVy F
+fVz F
+fVt F
+
+table O2ft0
+fIndexBCs I
+fAmplitudeA F[]
+fChannelA b[]
+fAmplitudeC F[]
+fChannelC b[]
+fTimeA F
+fTimeC F
+fTriggerMask b
+
+table O2fv0a
+fIndexBCs I
+fAmplitude F[]
+fChannel b[]
+fTime F
+fTriggerMask b
+
+table O2fdd_001
+fIndexBCs I
+fChargeA S[8]
+fChargeC S[8]
+fTimeA F
+fTimeC F
+fTriggerMask b
+
+table O2zdc_001
+fIndexBCs I
+fEnergy F[]
+fChannelE b[]
+fAmplitude F[]
+fTime F[]
+fChannelT b[]
+
+table O2mctracklabel
+fIndexMcParticles I
+fMcMask s
+
+table O2v0
+fIndexCollisions I
+fIndexTracks_Pos I
+fIndexTracks_Neg I
+fV0Type b
+
+table O2v0data
+fIndexV0s I
+fIndexCollisions I
+fIndexTracks_Pos I
+fIndexTracks_Neg I
+fPosX F
+fPosY F
+fPosZ F
+fPxPos F
+fPyPos F
+fPzPos F
+fPxNeg F
+fPyNeg F
+fPzNeg F
+fDCAV0Daughters F
+fDCAPosToPV F
+fDCANegToPV F
+fV0CosPA F
+fDCAV0ToPV F
+
+table O2mcv0label
+fIndexMcParticles I
+
+table O2hf2prong
+fIndexCollisions I
+fIndexTracks_0 I
+fIndexTracks_1 I
+fHFflag b
+
+table O2hfcand2prong
+fIndexCollisions I
+fPosX F
+fPosY F
+fPosZ F
+fXSecondaryVertex F
+fYSecondaryVertex F
+fZSecondaryVertex F
+fErrorDecayLength F
+fErrorDecayLengthXY F
+fChi2PCA F
+fPxProng0 F
+fPyProng0 F
+fPzProng0 F
+fPxProng1 F
+fPyProng1 F
+fPzProng1 F
+fImpactParameter0 F
+fImpactParameter1 F
+fErrorImpactParameter0 F
+fErrorImpactParameter1 F
+fIndexTracks_0 I
+fIndexTracks_1 I
+fHFflag b
+)";
+
+// Tables written by default: the inputs of the h1-h4 chains. Tracks, TracksCov
+// and TracksDCA come from o2-analysis-track-propagation, McV0Labels from the
+// lambdakzero label builder and the HF tables from the HF skim and candidate
+// creators, so they are only written on request (--tables). The FIT and ZDC
+// tables are read by the event selection of the h3, h4 and jet chains.
+const char* defaultTables = "O2bc,O2collision,O2mccollision,O2mccollisionlabel,O2track_iu,O2trackcov_iu,O2trackextra,O2mcparticle_001,O2mctracklabel,O2v0,O2v0data,O2ft0,O2fv0a,O2fdd_001,O2zdc_001";
+
+struct ColumnSpec {
+  std::string name;
+  char type;
+  int arraySize; // 0: scalar, -1: variable size, > 0: fixed size
+};
+
+struct TableSpec {
+  std::string name;
+  std::vector<ColumnSpec> columns;
+};
+
+std::vector<TableSpec> parseSchema(std::istream& in)
+{
+  std::vector<TableSpec> tables;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream words(line);
+    std::string first, second;
+    if (!(words >> first) || first[0] == '#') {
+      continue;
+    }
+    if (!(words >> second)) {
+      throw std::runtime_error("Schema line without type: " + line);
+    }
+    if (first == "table") {
+      tables.push_back({second, {}});
+      continue;
+    }
+    if (tables.empty()) {
+      throw std::runtime_error("Schema branch before the first table: " + line);
+    }
+    ColumnSpec column{first, second[0], 0};
+    if (second.size() > 1) {
+      if (second[1] != '[' || second.back() != ']') {
+        throw std::runtime_error("Arrays are written <type>[n] or <type>[]: " + line);
+      }
+      column.arraySize = second.size() == 3 ? -1 : std::stoi(second.substr(2, second.size() - 3));
+    }
+    if (std::string("BbSsIilF").find(column.type) == std::string::npos) {
+      throw std::runtime_error("Unknown leaf type: " + line);
+    }
+    tables.back().columns.push_back(column);
+  }
+  return tables;
+}
+
+/// Row buffer and TTree of one table; the tree is booked again for every dataframe
+class TableWriter
+{
+ public:
+  static constexpr int kMaxArraySize = 64;
+
+  explicit TableWriter(TableSpec const& spec) : mSpec(spec), mValues(spec.columns.size()), mArrays(spec.columns.size()), mArraySizes(spec.columns.size())
+  {
+    for (std::size_t i = 0; i < spec.columns.size(); ++i) {
+      if (spec.columns[i].arraySize != 0) {
+        mArrays[i].assign((spec.columns[i].arraySize > 0 ? spec.columns[i].arraySize : kMaxArraySize) * elementSize(spec.columns[i].type), 0);
+      }
+    }
+  }
+
+  /// Index of a branch, -1 if it is not in the schema (values set for it are dropped)
+  int column(std::string const& name) const
+  {
+    for (std::size_t i = 0; i < mSpec.columns.size(); ++i) {
+      if (mSpec.columns[i].name == name) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  void set(int column, double value)
+  {
+    if (column < 0) {
+      return;
+    }
+    mValues[column] = 0;
+    store(mSpec.columns[column].type, &mValues[column], value);
+  }
+
+  template <typename T>
+  void setArray(int column, std::vector<T> const& values)
+  {
+    if (column < 0) {
+      return;
+    }
+    const char type = mSpec.columns[column].type;
+    const std::size_t size = elementSize(type);
+    auto& array = mArrays[column];
+    const std::size_t n = std::min(values.size(), array.size() / size);
+    for (std::size_t i = 0; i < n; ++i) {
+      store(type, array.data() + i * size, values[i]);
+    }
+    mArraySizes[column] = n;
+  }
+
+  void book(TDirectory* directory)
+  {
+    directory->cd();
+    mTree = new TTree(mSpec.name.c_str(), mSpec.name.c_str());
+    for (std::size_t i = 0; i < mSpec.columns.size(); ++i) {
+      auto const& column = mSpec.columns[i];
+      if (column.arraySize == 0) {
+        mTree->Branch(column.name.c_str(), &mValues[i], (column.name + "/" + column.type).c_str());
+      } else if (column.arraySize > 0) {
+        mTree->Branch(column.name.c_str(), mArrays[i].data(), (column.name + "[" + std::to_string(column.arraySize) + "]/" + column.type).c_str());
+      } else {
+        const std::string sizeName = column.name + "_size";
+        mTree->Branch(sizeName.c_str(), &mArraySizes[i], (sizeName + "/I").c_str());
+        mTree->Branch(column.name.c_str(), mArrays[i].data(), (column.name + "[" + sizeName + "]/" + column.type).c_str());
+      }
+    }
+    mRows = 0;
+  }
+
+  /// Writes the current row and resets the buffer
+  void fill()
+  {
+    mTree->Fill();
+    std::fill(mValues.begin(), mValues.end(), 0);
+    std::fill(mArraySizes.begin(), mArraySizes.end(), 0);
+    for (auto& array : mArrays) {
+      std::fill(array.begin(), array.end(), 0);
+    }
+    ++mRows;
+  }
+
+  void write()
+  {
+    mTree->Write();
+    delete mTree;
+    mTree = nullptr;
+  }
+
+  int64_t rows() const { return mRows; }
+
+ private:
+  static std::size_t elementSize(char type)
+  {
+    switch (type) {
+      case 'B':
+      case 'b':
+        return 1;
+      case 'S':
+      case 's':
+        return 2;
+      case 'l':
+        return 8;
+      default:
+        return 4;
+    }
+  }
+
+  template <typename T>
+  static void storeAs(void* destination, double value)
+  {
+    T typed = static_cast<T>(value);
+    std::memcpy(destination, &typed, sizeof(T));
+  }
+
+  static void store(char type, void* destination, double value)
+  {
+    switch (type) {
+      case 'B':
+        storeAs<int8_t>(destination, value);
+        break;
+      case 'b':
+        storeAs<uint8_t>(destination, value);
+        break;
+      case 'S':
+        storeAs<int16_t>(destination, value);
+        break;
+      case 's':
+        storeAs<uint16_t>(destination, value);
+        break;
+      case 'I':
+        storeAs<int32_t>(destination, value);
+        break;
+      case 'i':
+        storeAs<uint32_t>(destination, value);
+        break;
+      case 'l':
+        storeAs<uint64_t>(destination, value);
+        break;
+      case 'F':
+        storeAs<float>(destination, value);
+        break;
+    }
+  }
+
+  TableSpec mSpec;
+  std::vector<uint64_t> mValues; // scalars, 8 bytes each whatever the type
+  std::vector<std::vector<uint8_t>> mArrays; // elements of the branch type
+  std::vector<int32_t> mArraySizes;
+  TTree* mTree = nullptr;
+  int64_t mRows = 0;
+};
+
+/// Writer of one table that may be disabled: then setting and filling do nothing
+class Table
+{
+ public:
+  Table() = default;
+  explicit Table(TableWriter* writer) : mWriter(writer) {}
+
+  Table& set(const char* name, double value)
+  {
+    if (mWriter) {
+      auto [it, inserted] = mColumns.try_emplace(name, -1);
+      if (inserted) {
+        it->second = mWriter->column(name);
+      }
+      mWriter->set(it->second, value);
+    }
+    return *this;
+  }
+  template <typename T>
+  Table& setArray(const char* name, std::vector<T> const& values)
+  {
+    if (mWriter) {
+      mWriter->setArray(mWriter->column(name), values);
+    }
+    return *this;
+  }
+  void fill()
+  {
+    if (mWriter) {
+      mWriter->fill();
+    }
+  }
+
+ private:
+  TableWriter* mWriter = nullptr;
+  std::map<const char*, int> mColumns; // the names are literals, keyed by address
+};
+
+struct Options {
+  int64_t nEvents = 1000;
+  int eventsPerDataframe = 100;
+  std::string multiplicity = "nbd";
+  double multMean = 30.;
+  double multK = 1.5;
+  int multMin = 0;
+  int multMax = 100;
+  double etaMax = 0.9;
+  double v0Rate = 0.5;
+  double d0Rate = 0.05;
+  int runNumber = 505673; // pilot beam run of October 2021, as the LHC21k6 anchor period
+  uint64_t seed = 12345;
+};
+
+struct Species {
+  int pdg;
+  double mass;
+  int charge;
+};
+
+const Species kPion{211, 0.13957, 1};
+const Species kKaon{321, 0.493677, 1};
+const Species kProton{2212, 0.938272, 1};
+
+struct Decay {
+  int pdg;
+  double mass;
+  double ctau; // cm
+  Species positive;
+  Species negative;
+};
+
+const Decay kK0S{310, 0.497611, 2.6844, kPion, kPion};
+const Decay kLambda{3122, 1.115683, 7.89, kProton, kPion};
+const Decay kAntiLambda{-3122, 1.115683, 7.89, kPion, kProton};
+const Decay kD0{421, 1.86484, 0.01229, kPion, kKaon};
+const Decay kD0bar{-421, 1.86484, 0.01229, kKaon, kPion};
+
+constexpr uint8_t kPhysicalPrimary = 0x2;
+constexpr uint8_t kProducedByTransport = 0x1;
+constexpr uint8_t kTrackIU = 1;
+constexpr uint8_t kD0ToPiKFlag = 0x1;
+constexpr uint32_t kPVContributor = 0x200000;
+// FT0 trigger bits A, C, vertex (TVX) and data valid
+constexpr uint8_t kFT0TriggerTVX = 0x87;
+// position of the collisions in their orbit: away from the time-frame start
+// (first 300 BCs) and in the middle of a 198-BC ITS readout frame, so that
+// sel8 does not reject them
+constexpr int kBCInOrbit = 1287;
+constexpr double kSpeedOfLight = 29.9792458; // cm/ns
+
+class Generator
+{
+ public:
+  Generator(Options const& options, std::map<std::string, TableWriter*> const& writers) : mOptions(options), mRandom(options.seed)
+  {
+    auto table = [&](const char* name) {
+      auto it = writers.find(name);
+      return Table(it == writers.end() ? nullptr : it->second);
+    };
+    mBCs = table("O2bc");
+    mCollisions = table("O2collision");
+    mMcCollisions = table("O2mccollision");
+    mMcCollisionLabels = table("O2mccollisionlabel");
+    mTracksIU = table("O2track_iu");
+    mTracksCovIU = table("O2trackcov_iu");
+    mTracks = table("O2track");
+    mTracksCov = table("O2trackcov");
+    mTracksDCA = table("O2trackdca");
+    mTracksExtra = table("O2trackextra");
+    mMcParticles = table("O2mcparticle_001");
+    mFT0s = table("O2ft0");
+    mFV0As = table("O2fv0a");
+    mFDDs = table("O2fdd_001");
+    mZdcs = table("O2zdc_001");
+    mMcTrackLabels = table("O2mctracklabel");
+    mV0s = table("O2v0");
+    mV0Datas = table("O2v0data");
+    mMcV0Labels = table("O2mcv0label");
+    mHf2Prongs = table("O2hf2prong");
+    mHfCand2Prongs = table("O2hfcand2prong");
+  }
+
+  /// Row counters are dataframe-local, as are the AO2D indices
+  void startDataframe()
+  {
+    mNCollisions = mNTracks = mNMcParticles = mNV0s = 0;
+  }
+
+  void generateEvent(int64_t iEvent)
+  {
+    const int collisionId = mNCollisions++;
+    mBCs.set("fRunNumber", mOptions.runNumber).set("fGlobalBC", static_cast<double>(iEvent) * 3564 + kBCInOrbit).fill();
+
+    std::normal_distribution<double> vertexXY(0., 0.005);
+    std::normal_distribution<double> vertexZ(0., 6.);
+    mVertex[0] = vertexXY(mRandom);
+    mVertex[1] = vertexXY(mRandom);
+    mVertex[2] = vertexZ(mRandom);
+    mMcCollisions.set("fIndexBCs", collisionId).set("fPosX", mVertex[0]).set("fPosY", mVertex[1]).set("fPosZ", mVertex[2]).set("fWeight", 1.).fill();
+
+    const int nPrimaries = sampleMultiplicity();
+    std::normal_distribution<double> vertexResolution(0., 0.002);
+    mCollisions.set("fIndexBCs", collisionId)
+      .set("fPosX", mVertex[0] + vertexResolution(mRandom))
+      .set("fPosY", mVertex[1] + vertexResolution(mRandom))
+      .set("fPosZ", mVertex[2] + vertexResolution(mRandom))
+      .set("fCovXX", 4e-6)
+      .set("fCovYY", 4e-6)
+      .set("fCovZZ", 4e-6)
+      .set("fChi2", 1.)
+      .set("fNumContrib", std::min(nPrimaries, 65535))
+      .set("fCollisionTimeRes", 10.)
+      .fill();
+    mMcCollisionLabels.set("fIndexMcCollisions", collisionId).fill();
+    addForwardDetectors(collisionId, nPrimaries);
+
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    for (int i = 0; i < nPrimaries; ++i) {
+      double r = uniform(mRandom);
+      Species const& species = r < 0.8 ? kPion : r < 0.92 ? kKaon : kProton;
+      int charge = uniform(mRandom) < 0.5 ? 1 : -1;
+      TLorentzVector momentum = sampleMomentum(species.mass, 0.3);
+      int label = addMcParticle(collisionId, charge * species.pdg, momentum, mVertex, kPhysicalPrimary, {}, -1);
+      addTrack(collisionId, label, charge, momentum, mVertex, true);
+    }
+
+    std::poisson_distribution<int> nV0s(mOptions.v0Rate);
+    for (int i = nV0s(mRandom); i > 0; --i) {
+      double r = uniform(mRandom);
+      injectDecay(collisionId, r < 0.5 ? kK0S : r < 0.75 ? kLambda : kAntiLambda);
+    }
+    std::poisson_distribution<int> nD0s(mOptions.d0Rate);
+    for (int i = nD0s(mRandom); i > 0; --i) {
+      injectDecay(collisionId, uniform(mRandom) < 0.5 ? kD0 : kD0bar);
+    }
+  }
+
+ private:
+  int sampleMultiplicity()
+  {
+    if (mOptions.multiplicity == "fixed") {
+      return static_cast<int>(mOptions.multMean);
+    }
+    if (mOptions.multiplicity == "uniform") {
+      return std::uniform_int_distribution<int>(mOptions.multMin, mOptions.multMax)(mRandom);
+    }
+    double mean = mOptions.multMean;
+    if (mOptions.multiplicity == "nbd") {
+      // negative binomial as a gamma-Poisson mixture
+      mean = std::gamma_distribution<double>(mOptions.multK, mOptions.multMean / mOptions.multK)(mRandom);
+    }
+    return std::poisson_distribution<int>(mean)(mRandom);
+  }
+
+  /// pT from a gamma(2, T) spectrum, flat in eta and phi
+  TLorentzVector sampleMomentum(double mass, double temperature)
+  {
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    double pt = -temperature * std::log(uniform(mRandom) * uniform(mRandom) + 1e-12);
+    double eta = (2. * uniform(mRandom) - 1.) * mOptions.etaMax;
+    double phi = 2. * M_PI * uniform(mRandom);
+    TLorentzVector momentum;
+    momentum.SetPtEtaPhiM(std::max(pt, 0.05), eta, phi, mass);
+    return momentum;
+  }
+
+  /// FIT signals with the TVX trigger and an empty ZDC row in the BC of the collision
+  void addForwardDetectors(int bcId, int nPrimaries)
+  {
+    // a few channels, amplitudes scaling with the multiplicity
+    const std::vector<float> amplitudes(4, 5.f * nPrimaries / 4.f);
+    const std::vector<uint8_t> channels = {0, 1, 2, 3};
+    const double timeA = -mVertex[2] / kSpeedOfLight, timeC = mVertex[2] / kSpeedOfLight;
+    mFT0s.set("fIndexBCs", bcId)
+      .setArray("fAmplitudeA", amplitudes)
+      .setArray("fChannelA", channels)
+      .setArray("fAmplitudeC", amplitudes)
+      .setArray("fChannelC", channels)
+      .set("fTimeA", timeA)
+      .set("fTimeC", timeC)
+      .set("fTriggerMask", kFT0TriggerTVX)
+      .fill();
+    mFV0As.set("fIndexBCs", bcId).setArray("fAmplitude", amplitudes).setArray("fChannel", channels).set("fTime", timeA).fill();
+    const std::vector<int16_t> charges(8, std::min(10 * nPrimaries, 32767));
+    mFDDs.set("fIndexBCs", bcId).setArray("fChargeA", charges).setArray("fChargeC", charges).set("fTimeA", timeA).set("fTimeC", timeC).fill();
+    mZdcs.set("fIndexBCs", bcId).fill();
+  }
+
+  int addMcParticle(int collisionId, int pdg, TLorentzVector const& p, const double* vertex, uint8_t flags, std::vector<int32_t> const& mothers, int firstDaughter)
+  {
+    mMcParticles.set("fIndexMcCollisions", collisionId)
+      .set("fPdgCode", pdg)
+      .set("fStatusCode", firstDaughter < 0 ? 1 : 2)
+      .set("fFlags", flags)
+      .setArray("fIndexArray_Mothers", mothers)
+      .setArray("fIndexSlice_Daughters", std::vector<int32_t>{firstDaughter, firstDaughter < 0 ? -1 : firstDaughter + 1})
+      .set("fWeight", 1.)
+      .set("fPx", p.Px())
+      .set("fPy", p.Py())
+      .set("fPz", p.Pz())
+      .set("fE", p.E())
+      .set("fVx", vertex[0])
+      .set("fVy", vertex[1])
+      .set("fVz", vertex[2])
+      .fill();
+    return mNMcParticles++;
+  }
+
+  /// Track with snp = 0 at its production point, in the frame rotated by its azimuth.
+  /// Returns the track index and the signed transverse distance to the primary vertex
+  std::pair<int, double> addTrack(int collisionId, int label, int charge, TLorentzVector const& p, const double* vertex, bool primary)
+  {
+    std::normal_distribution<double> gaus(0., 1.);
+    const double alpha = p.Phi();
+    const double ca = std::cos(alpha), sa = std::sin(alpha);
+    const double x = vertex[0] * ca + vertex[1] * sa;
+    const double dcaXY = -(vertex[0] - mVertex[0]) * sa + (vertex[1] - mVertex[1]) * ca + 0.002 * gaus(mRandom);
+    const double y = -mVertex[0] * sa + mVertex[1] * ca + dcaXY;
+    const double z = vertex[2] + 0.002 * gaus(mRandom);
+    const double pt = p.Pt() * (1. + (0.01 + 0.005 * p.Pt()) * gaus(mRandom));
+    const double signed1Pt = charge / pt;
+    const double tgl = p.Pz() / p.Pt();
+
+    for (auto* tracks : {&mTracksIU, &mTracks}) {
+      tracks->set("fIndexCollisions", collisionId)
+        .set("fTrackType", kTrackIU)
+        .set("fX", x)
+        .set("fAlpha", alpha)
+        .set("fY", y)
+        .set("fZ", z)
+        .set("fTgl", tgl)
+        .set("fSigned1Pt", signed1Pt)
+        .fill();
+    }
+    for (auto* covariances : {&mTracksCovIU, &mTracksCov}) {
+      covariances->set("fSigmaY", 0.005).set("fSigmaZ", 0.005).set("fSigmaSnp", 0.001).set("fSigmaTgl", 0.001).set("fSigma1Pt", 0.01 * std::abs(signed1Pt)).fill();
+    }
+    mTracksDCA.set("fDcaXY", dcaXY).set("fDcaZ", z - mVertex[2]).fill();
+
+    // simple Bethe-Bloch like dE/dx, 6% resolution
+    const double betaGamma = p.P() / p.M();
+    const double dEdx = std::min(50. * (1. + 1. / (betaGamma * betaGamma)), 1000.) * (1. + 0.06 * gaus(mRandom));
+    const int crossedRows = 120 + std::uniform_int_distribution<int>(0, 30)(mRandom);
+    mTracksExtra.set("fTPCInnerParam", p.P())
+      .set("fFlags", primary ? kPVContributor : 0u)
+      .set("fITSClusterMap", primary ? 0x3f : 0x30)
+      .set("fTPCNClsFindable", 155)
+      .set("fTPCNClsFindableMinusFound", 155 - crossedRows + 2)
+      .set("fTPCNClsFindableMinusCrossedRows", 155 - crossedRows)
+      .set("fITSChi2NCl", 1.)
+      .set("fTPCChi2NCl", 1.)
+      .set("fTPCSignal", dEdx)
+      .set("fLength", 400.)
+      .set("fTOFExpMom", p.P())
+      .set("fTrackEtaEMCAL", -999.)
+      .set("fTrackPhiEMCAL", -999.)
+      .set("fTrackTimeRes", 100.)
+      .fill();
+    mMcTrackLabels.set("fIndexMcParticles", label).fill();
+    return {mNTracks++, dcaXY};
+  }
+
+  void injectDecay(int collisionId, Decay const& decay)
+  {
+    TLorentzVector mother = sampleMomentum(decay.mass, 0.5);
+    std::exponential_distribution<double> flight(1.);
+    const double length = flight(mRandom) * decay.ctau * mother.P() / decay.mass;
+    const TVector3 direction = mother.Vect().Unit();
+    const double secondary[3] = {mVertex[0] + length * direction.X(), mVertex[1] + length * direction.Y(), mVertex[2] + length * direction.Z()};
+
+    // isotropic two-body decay in the rest frame
+    const double m1 = decay.positive.mass, m2 = decay.negative.mass, m = decay.mass;
+    const double pStar = std::sqrt((m * m - (m1 + m2) * (m1 + m2)) * (m * m - (m1 - m2) * (m1 - m2))) / (2. * m);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    const double cosTheta = 2. * uniform(mRandom) - 1., phi = 2. * M_PI * uniform(mRandom);
+    TVector3 direction1;
+    direction1.SetMagThetaPhi(pStar, std::acos(cosTheta), phi);
+    TLorentzVector positive(direction1, std::hypot(pStar, m1));
+    TLorentzVector negative(-direction1, std::hypot(pStar, m2));
+    positive.Boost(mother.BoostVector());
+    negative.Boost(mother.BoostVector());
+
+    const int motherLabel = addMcParticle(collisionId, decay.pdg, mother, mVertex, kPhysicalPrimary, {}, mNMcParticles + 1);
+    const int positiveLabel = addMcParticle(collisionId, decay.positive.pdg, positive, secondary, kProducedByTransport, {motherLabel}, -1);
+    const int negativeLabel = addMcParticle(collisionId, -decay.negative.pdg, negative, secondary, kProducedByTransport, {motherLabel}, -1);
+    auto [positiveTrack, positiveDca] = addTrack(collisionId, positiveLabel, 1, positive, secondary, false);
+    auto [negativeTrack, negativeDca] = addTrack(collisionId, negativeLabel, -1, negative, secondary, false);
+
+    std::normal_distribution<double> gaus(0., 1.);
+    const TVector3 flightLine(secondary[0] - mVertex[0], secondary[1] - mVertex[1], secondary[2] - mVertex[2]);
+    const double cosPA = flightLine.Mag() > 0. ? std::cos(flightLine.Angle(mother.Vect())) : 1.;
+    if (std::abs(decay.pdg) == kD0.pdg) {
+      for (auto* candidates : {&mHf2Prongs, &mHfCand2Prongs}) {
+        candidates->set("fIndexCollisions", collisionId).set("fIndexTracks_0", positiveTrack).set("fIndexTracks_1", negativeTrack).set("fHFflag", kD0ToPiKFlag);
+      }
+      mHf2Prongs.fill();
+      mHfCand2Prongs.set("fPosX", mVertex[0])
+        .set("fPosY", mVertex[1])
+        .set("fPosZ", mVertex[2])
+        .set("fXSecondaryVertex", secondary[0])
+        .set("fYSecondaryVertex", secondary[1])
+        .set("fZSecondaryVertex", secondary[2])
+        .set("fErrorDecayLength", 0.005)
+        .set("fErrorDecayLengthXY", 0.005)
+        .set("fChi2PCA", 1e-4)
+        .set("fPxProng0", positive.Px())
+        .set("fPyProng0", positive.Py())
+        .set("fPzProng0", positive.Pz())
+        .set("fPxProng1", negative.Px())
+        .set("fPyProng1", negative.Py())
+        .set("fPzProng1", negative.Pz())
+        .set("fImpactParameter0", positiveDca)
+        .set("fImpactParameter1", negativeDca)
+        .set("fErrorImpactParameter0", 0.002)
+        .set("fErrorImpactParameter1", 0.002)
+        .fill();
+      return;
+    }
+
+    const int v0Id = mNV0s++;
+    mV0s.set("fIndexCollisions", collisionId).set("fIndexTracks_Pos", positiveTrack).set("fIndexTracks_Neg", negativeTrack).set("fV0Type", 1).fill();
+    mV0Datas.set("fIndexV0s", v0Id)
+      .set("fIndexCollisions", collisionId)
+      .set("fIndexTracks_Pos", positiveTrack)
+      .set("fIndexTracks_Neg", negativeTrack)
+      .set("fPosX", secondary[0] + 0.01 * gaus(mRandom))
+      .set("fPosY", secondary[1] + 0.01 * gaus(mRandom))
+      .set("fPosZ", secondary[2] + 0.01 * gaus(mRandom))
+      .set("fPxPos", positive.Px())
+      .set("fPyPos", positive.Py())
+      .set("fPzPos", positive.Pz())
+      .set("fPxNeg", negative.Px())
+      .set("fPyNeg", negative.Py())
+      .set("fPzNeg", negative.Pz())
+      .set("fDCAV0Daughters", std::abs(0.1 * gaus(mRandom)))
+      .set("fDCAPosToPV", positiveDca)
+      .set("fDCANegToPV", negativeDca)
+      .set("fV0CosPA", cosPA)
+      .set("fDCAV0ToPV", std::abs(0.01 * gaus(mRandom)))
+      .fill();
+    mMcV0Labels.set("fIndexMcParticles", motherLabel).fill();
+  }
+
+  Options mOptions;
+  std::mt19937_64 mRandom;
+  double mVertex[3] = {0., 0., 0.};
+  int mNCollisions = 0;
+  int mNTracks = 0;
+  int mNMcParticles = 0;
+  int mNV0s = 0;
+
+  Table mBCs, mCollisions, mMcCollisions, mMcCollisionLabels;
+  Table mTracksIU, mTracksCovIU, mTracks, mTracksCov, mTracksDCA, mTracksExtra;
+  Table mMcParticles, mMcTrackLabels;
+  Table mFT0s, mFV0As, mFDDs, mZdcs;
+  Table mV0s, mV0Datas, mMcV0Labels;
+  Table mHf2Prongs, mHfCand2Prongs;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  namespace po = boost::program_options;
+  Options options;
+  std::string output, schemaFile, tables;
+  po::options_description description("Writes a synthetic MC AO2D file");
+  description.add_options()("help,h", "print this help")                                                                                  //
+    ("output,o", po::value(&output)->default_value("AO2D-synthetic.root"), "output file")                                                //
+    ("events,n", po::value(&options.nEvents)->default_value(options.nEvents), "number of collisions")                                    //
+    ("df-size", po::value(&options.eventsPerDataframe)->default_value(options.eventsPerDataframe), "collisions per dataframe (DF_ directory)") //
+    ("multiplicity", po::value(&options.multiplicity)->default_value(options.multiplicity), "primary multiplicity distribution: fixed, poisson, nbd, uniform") //
+    ("mult-mean", po::value(&options.multMean)->default_value(options.multMean), "mean multiplicity (fixed, poisson, nbd)")                //
+    ("mult-k", po::value(&options.multK)->default_value(options.multK), "shape k of the negative binomial")                              //
+    ("mult-min", po::value(&options.multMin)->default_value(options.multMin), "lower multiplicity (uniform)")                             //
+    ("mult-max", po::value(&options.multMax)->default_value(options.multMax), "upper multiplicity (uniform)")                             //
+    ("eta-max", po::value(&options.etaMax)->default_value(options.etaMax), "pseudorapidity range of the particles")                       //
+    ("v0-rate", po::value(&options.v0Rate)->default_value(options.v0Rate), "mean injected K0S/Lambda/AntiLambda per collision")          //
+    ("d0-rate", po::value(&options.d0Rate)->default_value(options.d0Rate), "mean injected D0/D0bar per collision")                       //
+    ("run-number", po::value(&options.runNumber)->default_value(options.runNumber), "run number of the BCs, must exist in the CCDB if the chain runs the timestamp task") //
+    ("seed", po::value(&options.seed)->default_value(options.seed), "random seed")                                                       //
+    ("tables", po::value(&tables)->default_value(defaultTables), "comma-separated list of trees to write")                               //
+    ("schema", po::value(&schemaFile), "schema file replacing the built-in one")                                                         //
+    ("dump-schema", "print the built-in schema and exit");
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, description), vm);
+    po::notify(vm);
+  } catch (po::error const& e) {
+    std::cerr << e.what() << "\n"
+              << description << "\n";
+    return 1;
+  }
+  if (vm.count("help")) {
+    std::cout << description << "\n";
+    return 0;
+  }
+  if (vm.count("dump-schema")) {
+    std::cout << defaultSchema;
+    return 0;
+  }
+  if (options.eventsPerDataframe <= 0 || options.multK <= 0.) {
+    std::cerr << "df-size and mult-k must be positive\n";
+    return 1;
+  }
+
+  std::vector<TableSpec> schema;
+  try {
+    if (schemaFile.empty()) {
+      std::istringstream in(defaultSchema);
+      schema = parseSchema(in);
+    } else {
+      std::ifstream in(schemaFile);
+      if (!in) {
+        std::cerr << "Cannot open " << schemaFile << "\n";
+        return 1;
+      }
+      schema = parseSchema(in);
+    }
+  } catch (std::exception const& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::set<std::string> selected;
+  std::istringstream tableList(tables);
+  for (std::string name; std::getline(tableList, name, ',');) {
+    selected.insert(name);
+  }
+  std::vector<std::unique_ptr<TableWriter>> ownedWriters;
+  std::map<std::string, TableWriter*> writers;
+  for (auto const& table : schema) {
+    if (selected.erase(table.name)) {
+      ownedWriters.push_back(std::make_unique<TableWriter>(table));
+      writers[table.name] = ownedWriters.back().get();
+    }
+  }
+  for (auto const& name : selected) {
+    std::cerr << "Table " << name << " is not in the schema\n";
+    return 1;
+  }
+
+  TFile file(output.c_str(), "RECREATE");
+  TMap metaData;
+  metaData.Add(new TObjString("DataType"), new TObjString("MC"));
+  metaData.Add(new TObjString("Run"), new TObjString("3"));
+  file.WriteObject(&metaData, "metaData");
+
+  Generator generator(options, writers);
+  for (int64_t firstEvent = 0; firstEvent < options.nEvents; firstEvent += options.eventsPerDataframe) {
+    auto* directory = file.mkdir(("DF_" + std::to_string(1 + firstEvent / options.eventsPerDataframe)).c_str());
+    for (auto& writer : ownedWriters) {
+      writer->book(directory);
+    }
+    generator.startDataframe();
+    const int64_t lastEvent = std::min(firstEvent + options.eventsPerDataframe, options.nEvents);
+    for (int64_t iEvent = firstEvent; iEvent < lastEvent; ++iEvent) {
+      generator.generateEvent(iEvent);
+    }
+    directory->cd();
+    for (auto& writer : ownedWriters) {
+      writer->write();
+    }
+    std::cout << "Written " << lastEvent << " / " << options.nEvents << " collisions\r" << std::flush;
+  }
+  std::cout << "\n";
+  file.Close();
+  return 0;
+}